@@ -0,0 +1,457 @@
+// Cross-checkpoint performance report. Runs each checkpoint's headless build
+// (checkpointN_bench: typewriter delays compiled out, allocations counted by
+// alloc_counter.cpp) through a scripted playthrough on stdin and records,
+// over --runs runs (the fastest for times, the median for the rest):
+//   startup_ms         wall time of a session that enters a name and quits
+//   playthrough_ms     wall time of the whole playthrough
+//   input_latency_us   (playthrough - startup) per input line past the startup
+//   peak_rss_kb        peak resident set size of the playthrough
+//   startup_allocations, allocations_per_input, bytes_per_input
+//                      heap allocations, counted the same way
+// An input line is one menu choice, answer or "Press Enter", which is the
+// closest thing to a turn that all five checkpoints share.
+//
+// The report is written as JSON. Given a --baseline report it exits non-zero
+// if any metric of a checkpoint in both got worse by more than --tolerance.
+//
+// Build: cmake --build build --target perf_report   (runs it, see CMakeLists.txt)
+//
+// Usage: checkpoint_report --checkpoint <name> <binary> <script> <quit> ...
+//                          [--runs <n>] [--timeout <seconds>] [--out <file>]
+//                          [--baseline <file>] [--tolerance <fraction>]
+//   --checkpoint  a checkpoint to measure: its name, its bench binary, a
+//                 playthrough script (one input per line, starting with the
+//                 player name) and, comma-separated, the inputs that quit
+//                 from the first menu; the startup run is the name plus those
+//   --runs        runs of each input per checkpoint (default: 20)
+//   --timeout     seconds before a run is killed and the report fails (default: 30)
+//   --out         report file (default: perf_report.json)
+//   --baseline    earlier report to compare against
+//   --tolerance   allowed regression, as a fraction of the baseline (default: 0.10)
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+struct Checkpoint {
+    std::string name;
+    std::string binary;
+    std::string playthrough;
+    std::string startup;
+};
+
+struct Run {
+    double seconds = 0;
+    double peakRssKb = 0;
+    double allocations = 0;
+    double bytes = 0;
+};
+
+// Metrics in report order. All of them are costs: a larger value is worse.
+const char* const METRICS[] = {
+    "startup_ms", "playthrough_ms", "input_latency_us", "peak_rss_kb",
+    "startup_allocations", "allocations_per_input", "bytes_per_input",
+};
+
+using Report = std::map<std::string, std::map<std::string, double>>;
+
+std::atomic<pid_t> runningChild{0};
+
+// SIGALRM fires when a run outlives --timeout
+void killRunningChild(int) {
+    pid_t pid = runningChild.load();
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+    }
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot read " + path);
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+size_t countLines(const std::string& input) {
+    return static_cast<size_t>(std::count(input.begin(), input.end(), '\n'));
+}
+
+Checkpoint makeCheckpoint(std::string name, std::string binary, const std::string& scriptPath,
+                          const std::string& quit) {
+    Checkpoint checkpoint{std::move(name), std::move(binary), readFile(scriptPath), ""};
+    if (!checkpoint.playthrough.empty() && checkpoint.playthrough.back() != '\n') {
+        checkpoint.playthrough += '\n';
+    }
+    checkpoint.startup = checkpoint.playthrough.substr(0, checkpoint.playthrough.find('\n') + 1);
+    std::istringstream lines(quit);
+    for (std::string line; std::getline(lines, line, ',');) {
+        checkpoint.startup += line + '\n';
+    }
+    if (countLines(checkpoint.playthrough) <= countLines(checkpoint.startup)) {
+        throw std::invalid_argument(scriptPath + " has no inputs past the name and quit of " +
+                                    checkpoint.name);
+    }
+    return checkpoint;
+}
+
+// Runs binary with input on stdin and its output discarded. The wall time
+// covers exec, startup and exit; the peak RSS is the child's alone because
+// posix_spawn shares this process's memory until the exec.
+Run runOnce(const Checkpoint& checkpoint, const std::string& input, const std::string& allocPath,
+            unsigned timeoutSeconds) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    std::string allocVariable = "SPACE_DYSTOPIA_ALLOC_REPORT=" + allocPath;
+    std::vector<char*> env;
+    for (char** e = environ; *e; ++e) {
+        if (std::strncmp(*e, "SPACE_DYSTOPIA_ALLOC_REPORT=", 28) != 0) {
+            env.push_back(*e);
+        }
+    }
+    env.push_back(allocVariable.data());
+    env.push_back(nullptr);
+    char* argv[] = {const_cast<char*>(checkpoint.binary.c_str()), nullptr};
+    unlink(allocPath.c_str());
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int spawnError = posix_spawn(&pid, argv[0], &actions, nullptr, argv, env.data());
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (spawnError != 0) {
+        close(fds[1]);
+        throw std::runtime_error("Cannot run " + checkpoint.binary + ": " + std::strerror(spawnError));
+    }
+    runningChild = pid;
+    itimerval timer{};
+    timer.it_value.tv_sec = timeoutSeconds;
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    // A checkpoint that quits before reading everything closes the pipe;
+    // SIGPIPE is ignored, so the write just stops
+    for (size_t written = 0; written < input.size();) {
+        ssize_t n = write(fds[1], input.data() + written, input.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    close(fds[1]);
+
+    int status = 0;
+    rusage usage{};
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+    }
+    auto end = std::chrono::steady_clock::now();
+    timer = itimerval{};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    runningChild = 0;
+
+    if (WIFSIGNALED(status)) {
+        throw std::runtime_error(checkpoint.name + (WTERMSIG(status) == SIGKILL
+            ? " did not finish within " + std::to_string(timeoutSeconds) + " s"
+            : " died of signal " + std::to_string(WTERMSIG(status))));
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error(checkpoint.name + " exited with status " +
+                                 std::to_string(WEXITSTATUS(status)));
+    }
+
+    Run run;
+    run.seconds = std::chrono::duration<double>(end - start).count();
+    run.peakRssKb = static_cast<double>(usage.ru_maxrss);
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0;
+    FILE* counts = std::fopen(allocPath.c_str(), "r");
+    bool counted = counts && std::fscanf(counts, "allocations %llu bytes %llu", &allocations, &bytes) == 2;
+    if (counts) {
+        std::fclose(counts);
+    }
+    if (!counted) {
+        throw std::runtime_error(checkpoint.binary + " reported no allocation counts; "
+                                 "is it linked with alloc_counter.cpp?");
+    }
+    run.allocations = static_cast<double>(allocations);
+    run.bytes = static_cast<double>(bytes);
+    return run;
+}
+
+// A run is only ever slowed down by the machine, so the fastest is the
+// truest time; counts and sizes barely vary and take the median
+double fastest(const std::vector<Run>& runs) {
+    return std::min_element(runs.begin(), runs.end(),
+        [](const Run& a, const Run& b) { return a.seconds < b.seconds; })->seconds;
+}
+
+double median(std::vector<Run>& runs, double Run::*field) {
+    std::sort(runs.begin(), runs.end(), [field](const Run& a, const Run& b) { return a.*field < b.*field; });
+    size_t middle = runs.size() / 2;
+    return runs.size() % 2 ? runs[middle].*field : (runs[middle - 1].*field + runs[middle].*field) / 2;
+}
+
+std::map<std::string, double> measure(const Checkpoint& checkpoint, unsigned runCount,
+                                      const std::string& allocPath, unsigned timeoutSeconds) {
+    std::vector<Run> startups;
+    std::vector<Run> playthroughs;
+    // Interleaved, so that a burst of machine noise hits both alike
+    for (unsigned i = 0; i < runCount; ++i) {
+        startups.push_back(runOnce(checkpoint, checkpoint.startup, allocPath, timeoutSeconds));
+        playthroughs.push_back(runOnce(checkpoint, checkpoint.playthrough, allocPath, timeoutSeconds));
+    }
+    double inputs = static_cast<double>(countLines(checkpoint.playthrough) - countLines(checkpoint.startup));
+    double startup = fastest(startups);
+    double playthrough = fastest(playthroughs);
+    double startupAllocations = median(startups, &Run::allocations);
+    double startupBytes = median(startups, &Run::bytes);
+
+    std::map<std::string, double> metrics;
+    metrics["inputs"] = inputs;
+    metrics["startup_ms"] = startup * 1e3;
+    metrics["playthrough_ms"] = playthrough * 1e3;
+    metrics["input_latency_us"] = std::max(0.0, playthrough - startup) / inputs * 1e6;
+    metrics["peak_rss_kb"] = median(playthroughs, &Run::peakRssKb);
+    metrics["startup_allocations"] = startupAllocations;
+    metrics["allocations_per_input"] =
+        std::max(0.0, median(playthroughs, &Run::allocations) - startupAllocations) / inputs;
+    metrics["bytes_per_input"] = std::max(0.0, median(playthroughs, &Run::bytes) - startupBytes) / inputs;
+    return metrics;
+}
+
+void writeReport(std::ostream& out, const std::vector<Checkpoint>& checkpoints, const Report& report,
+                 unsigned runCount) {
+    out << "{\n  \"runs\": " << runCount << ",\n  \"checkpoints\": [\n";
+    for (size_t i = 0; i < checkpoints.size(); ++i) {
+        const auto& metrics = report.at(checkpoints[i].name);
+        out << "    {\"name\": \"" << checkpoints[i].name << "\", \"inputs\": " << metrics.at("inputs");
+        for (const char* metric : METRICS) {
+            out << ", \"" << metric << "\": " << std::fixed << std::setprecision(3) << metrics.at(metric)
+                << std::defaultfloat;
+        }
+        out << "}" << (i + 1 < checkpoints.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Reads back a report written by writeReport, or anything shaped like it:
+// objects of string and number members, each named by its "name"
+Report parseReport(const std::string& json) {
+    Report report;
+    size_t pos = json.find("\"checkpoints\"");
+    if (pos == std::string::npos) {
+        throw std::invalid_argument("Not a checkpoint report: no \"checkpoints\" array");
+    }
+    auto expect = [&json](size_t at, char c) {
+        if (at >= json.size() || json[at] != c) {
+            throw std::invalid_argument("Malformed report near offset " + std::to_string(at));
+        }
+    };
+    auto skipSpace = [&json](size_t at) {
+        while (at < json.size() && std::isspace(static_cast<unsigned char>(json[at]))) {
+            ++at;
+        }
+        return at;
+    };
+    auto readString = [&](size_t& at) {
+        expect(at, '"');
+        size_t close = json.find('"', at + 1);
+        expect(close, '"');
+        std::string text = json.substr(at + 1, close - at - 1);
+        at = close + 1;
+        return text;
+    };
+    pos = skipSpace(json.find(':', pos) + 1);
+    expect(pos, '[');
+    pos = skipSpace(pos + 1);
+    while (pos < json.size() && json[pos] == '{') {
+        std::string name;
+        std::map<std::string, double> metrics;
+        pos = skipSpace(pos + 1);
+        while (pos < json.size() && json[pos] != '}') {
+            std::string key = readString(pos);
+            pos = skipSpace(pos);
+            expect(pos, ':');
+            pos = skipSpace(pos + 1);
+            if (json[pos] == '"') {
+                std::string value = readString(pos);
+                if (key == "name") {
+                    name = value;
+                }
+            } else {
+                char* end = nullptr;
+                metrics[key] = std::strtod(json.c_str() + pos, &end);
+                if (end == json.c_str() + pos) {
+                    throw std::invalid_argument("Malformed number for " + key + " in report");
+                }
+                pos = static_cast<size_t>(end - json.c_str());
+            }
+            pos = skipSpace(pos);
+            if (pos < json.size() && json[pos] == ',') {
+                pos = skipSpace(pos + 1);
+            }
+        }
+        expect(pos, '}');
+        report[name] = std::move(metrics);
+        pos = skipSpace(pos + 1);
+        if (pos < json.size() && json[pos] == ',') {
+            pos = skipSpace(pos + 1);
+        }
+    }
+    return report;
+}
+
+// Prints every metric that got worse than baseline * (1 + tolerance) and
+// returns how many did
+size_t compare(const std::vector<Checkpoint>& checkpoints, const Report& report, const Report& baseline,
+               double tolerance) {
+    size_t regressions = 0;
+    for (const auto& checkpoint : checkpoints) {
+        auto before = baseline.find(checkpoint.name);
+        if (before == baseline.end()) {
+            std::cout << checkpoint.name << ": not in the baseline" << std::endl;
+            continue;
+        }
+        for (const char* metric : METRICS) {
+            auto old = before->second.find(metric);
+            if (old == before->second.end()) {
+                continue;
+            }
+            double now = report.at(checkpoint.name).at(metric);
+            if (now > old->second * (1 + tolerance)) {
+                std::cout << std::fixed << std::setprecision(3) << checkpoint.name << ": " << metric
+                          << " regressed from " << old->second << " to " << now << std::endl;
+                ++regressions;
+            }
+        }
+    }
+    return regressions;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<Checkpoint> checkpoints;
+    unsigned runCount = 20;
+    unsigned timeoutSeconds = 30;
+    std::string outPath = "perf_report.json";
+    std::string baselinePath;
+    double tolerance = 0.10;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--checkpoint" && i + 4 < argc) {
+                checkpoints.push_back(makeCheckpoint(argv[i + 1], argv[i + 2], argv[i + 3], argv[i + 4]));
+                i += 4;
+            } else if (arg == "--runs" && i + 1 < argc) {
+                runCount = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--timeout" && i + 1 < argc) {
+                timeoutSeconds = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--out" && i + 1 < argc) {
+                outPath = argv[++i];
+            } else if (arg == "--baseline" && i + 1 < argc) {
+                baselinePath = argv[++i];
+            } else if (arg == "--tolerance" && i + 1 < argc) {
+                tolerance = std::stod(argv[++i]);
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+        if (checkpoints.empty()) {
+            std::cerr << "Nothing to measure; give at least one --checkpoint" << std::endl;
+            return 1;
+        }
+
+        struct sigaction onAlarm{};
+        onAlarm.sa_handler = killRunningChild;
+        sigaction(SIGALRM, &onAlarm, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        char allocTemplate[] = "/tmp/checkpoint_report.XXXXXX";
+        int allocFd = mkstemp(allocTemplate);
+        if (allocFd < 0) {
+            throw std::runtime_error(std::string("mkstemp: ") + std::strerror(errno));
+        }
+        close(allocFd);
+        std::string allocPath = allocTemplate;
+
+        Report report;
+        try {
+            for (const auto& checkpoint : checkpoints) {
+                report[checkpoint.name] = measure(checkpoint, runCount, allocPath, timeoutSeconds);
+                const auto& metrics = report[checkpoint.name];
+                std::cout << std::fixed << std::setprecision(2) << checkpoint.name
+                          << ": startup " << metrics.at("startup_ms") << " ms, "
+                          << metrics.at("input_latency_us") << " us/input, "
+                          << std::setprecision(0) << metrics.at("peak_rss_kb") << " KB peak, "
+                          << metrics.at("startup_allocations") << " allocations at startup, "
+                          << std::setprecision(1) << metrics.at("allocations_per_input") << " per input"
+                          << std::endl;
+            }
+        } catch (...) {
+            unlink(allocPath.c_str());
+            throw;
+        }
+        unlink(allocPath.c_str());
+
+        std::ofstream out(outPath);
+        writeReport(out, checkpoints, report, runCount);
+        if (!out.flush()) {
+            throw std::runtime_error("Cannot write " + outPath);
+        }
+        std::cout << "Report written to " << outPath << std::endl;
+
+        if (!baselinePath.empty()) {
+            size_t regressions = compare(checkpoints, report, parseReport(readFile(baselinePath)), tolerance);
+            if (regressions) {
+                std::cout << regressions << " metric(s) regressed by more than " << std::setprecision(0)
+                          << tolerance * 100 << "% against " << baselinePath << std::endl;
+                return 2;
+            }
+            std::cout << "No regressions against " << baselinePath << std::endl;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,267 @@
+// Micro-benchmarks for the engine's hot paths, plus a full scripted
+// headless playthrough as the end-to-end number. These are the baselines
+// the performance work is measured against.
+//
+// Build: cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build --target engine_bench
+// Run:   build/engine_bench [--benchmark_filter=<regex>]
+
+#define SPACE_DYSTOPIA_NO_MAIN
+#include "../checkpoint5.cpp"
+
+#include <benchmark/benchmark.h>
+
+#ifndef SPACE_DYSTOPIA_SCRIPT
+#define SPACE_DYSTOPIA_SCRIPT "checkpoint/scripts/escape.txt"
+#endif
+
+namespace {
+
+// The built-in world's locations, built the way Game builds them
+Location makeLocation(size_t index) {
+    const auto& def = WorldData::builtin()->locations[index];
+    Location location{std::string(def.name), std::string(def.description)};
+    for (const auto& interaction : def.interactions) {
+        location.addInteraction(std::string(interaction.first), std::string(interaction.second));
+    }
+    return location;
+}
+
+void BM_LocationInteract(benchmark::State& state) {
+    Arena arena;
+    EntityStore entities;
+    Player* player = arena.make<Player>(entities, entities.createPlayer("Bench"));
+    if (state.range(0)) {
+        player->addItem(arena.make<Item>("Keycard", "A security keycard", true));
+    }
+    Location terminalRoom = makeLocation(1);
+    const InteractionId examine = Symbols::interactions().intern("examine terminal");
+    const InteractionId activate = Symbols::interactions().intern("activate airlock");
+    const InteractionId keys[] = {Names::HACK_TERMINAL, examine, activate};
+    for (auto _ : state) {
+        for (InteractionId key : keys) {
+            benchmark::DoNotOptimize(terminalRoom.interact(key, player));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(BM_LocationInteract)->ArgName("keycard")->Arg(0)->Arg(1);
+
+void BM_PlayerHasQuestFlag(benchmark::State& state) {
+    EntityStore entities;
+    Player player(entities, entities.createPlayer("Bench"));
+    player.setQuestFlag(Names::READ_CLASSIFIED_INFO);
+    player.setQuestFlag(Names::SECURITY_DEFEATED);
+    const FlagId flags[] = {Names::READ_CLASSIFIED_INFO, Names::TERMINAL_HACKED,
+                            Names::SECURITY_DEFEATED, Names::SPACESUIT_EQUIPPED};
+    for (auto _ : state) {
+        for (FlagId flag : flags) {
+            benchmark::DoNotOptimize(player.hasQuestFlag(flag));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_PlayerHasQuestFlag);
+
+void BM_PlayerHasItem(benchmark::State& state) {
+    Arena arena;
+    EntityStore entities;
+    Player player(entities, entities.createPlayer("Bench"));
+    player.addItem(arena.make<Item>("Datapad", "A tablet containing classified information", true));
+    player.addItem(arena.make<Item>("EMP Device", "Can disable security systems", true));
+    const ItemId items[] = {Names::DATAPAD, Names::KEYCARD, Names::SPACESUIT, Names::EMP_DEVICE};
+    for (auto _ : state) {
+        for (ItemId item : items) {
+            benchmark::DoNotOptimize(player.hasItem(item));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_PlayerHasItem);
+
+// The by-name lookup tools use, for comparison with the interned path
+void BM_PlayerHasItemByName(benchmark::State& state) {
+    Arena arena;
+    EntityStore entities;
+    Player player(entities, entities.createPlayer("Bench"));
+    player.addItem(arena.make<Item>("Datapad", "A tablet containing classified information", true));
+    const std::string_view names[] = {"Datapad", "Keycard", "Spacesuit", "EMP"};
+    for (auto _ : state) {
+        for (std::string_view name : names) {
+            benchmark::DoNotOptimize(player.hasItem(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_PlayerHasItemByName);
+
+// Removes an item from a location holding range(0) items and puts it back,
+// so the timed loop always sees the same location
+void BM_LocationRemoveItem(benchmark::State& state) {
+    Arena arena;
+    Location location = makeLocation(0);
+    std::vector<Item*> items;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        items.push_back(arena.make<Item>("Crate " + std::to_string(i), "Spare parts"));
+        location.addItem(items.back());
+    }
+    size_t next = 0;
+    for (auto _ : state) {
+        Item* item = items[next];
+        location.removeItem(item->getId());
+        location.addItem(item);
+        next = (next + 1) % items.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LocationRemoveItem)->RangeMultiplier(4)->Range(4, 256);
+
+void BM_StatModify(benchmark::State& state) {
+    StatBlock stats{};
+    stats.reset<Stats::HEALTH>(100);
+    int amount = -7;
+    for (auto _ : state) {
+        stats.modify<Stats::HEALTH>(amount);
+        amount = -amount;
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StatModify);
+
+// Snapshotting a batch of entities' stats, as a save or a combat rollback would
+void BM_StatBlockSnapshot(benchmark::State& state) {
+    std::vector<StatBlock> live(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < live.size(); ++i) {
+        live[i] = StatBlock{};
+        live[i].reset<Stats::HEALTH>(static_cast<int32_t>(50 + i % 50));
+        live[i].reset<Stats::ATTACK>(10);
+    }
+    std::vector<StatBlock> snapshot(live.size());
+    for (auto _ : state) {
+        std::memcpy(snapshot.data(), live.data(), live.size() * sizeof(StatBlock));
+        benchmark::DoNotOptimize(snapshot.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(live.size() * sizeof(StatBlock)));
+}
+BENCHMARK(BM_StatBlockSnapshot)->Arg(64)->Arg(4096);
+
+// One batch of strikes between store rows, loaded the way handleCombat does
+void BM_CombatResolve(benchmark::State& state) {
+    const uint32_t pairs = static_cast<uint32_t>(state.range(0));
+    EntityStore entities;
+    for (uint32_t i = 0; i < pairs; ++i) {
+        entities.createPlayer("Bench");
+        entities.createEnemy("Security Bot", "Robot", 50, 10, 3);
+    }
+    std::vector<Combat::Strike> strikes;
+    for (uint32_t i = 0; i < pairs; ++i) {
+        strikes.push_back({2 * i, 2 * i + 1, 1});
+        strikes.push_back({2 * i + 1, 2 * i, 1});
+    }
+    std::vector<int> dealt(strikes.size());
+    Combat::CombatTable table;
+    Rng rng(42);
+    for (auto _ : state) {
+        table.clear();
+        for (const StatBlock& stats : entities.stats) {
+            table.add(stats);
+        }
+        table.resolve(strikes.data(), strikes.size(), rng, dealt.data());
+        benchmark::DoNotOptimize(dealt.data());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(strikes.size()));
+}
+BENCHMARK(BM_CombatResolve)->Arg(1)->Arg(256);
+
+// A width x width grid of rooms, each with doors to its neighbours
+StationMap makeGridStation(uint32_t width) {
+    std::vector<std::pair<uint32_t, uint32_t>> exits;
+    for (uint32_t y = 0; y < width; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t room = y * width + x;
+            if (x + 1 < width) exits.emplace_back(room, room + 1);
+            if (y + 1 < width) exits.emplace_back(room, room + width);
+        }
+    }
+    return StationMap(size_t(width) * width, exits);
+}
+
+// Building the station graph and the routes to one destination
+void BM_StationMapRoute(benchmark::State& state) {
+    const uint32_t width = static_cast<uint32_t>(state.range(0));
+    for (auto _ : state) {
+        StationMap map = makeGridStation(width);
+        benchmark::DoNotOptimize(map.distance(0, width * width - 1));
+    }
+}
+BENCHMARK(BM_StationMapRoute)->ArgName("width")->Arg(8)->Arg(32)->Arg(128);
+
+// Next-hop lookups once the routes are cached, as travel and NPCs use them
+void BM_StationMapNextHop(benchmark::State& state) {
+    const uint32_t width = static_cast<uint32_t>(state.range(0));
+    const uint32_t rooms = width * width;
+    StationMap map = makeGridStation(width);
+    const uint32_t destinations[] = {0, rooms / 2, rooms - 1};
+    for (uint32_t destination : destinations) {
+        map.routesTo(destination);
+    }
+    uint32_t room = 1;
+    for (auto _ : state) {
+        for (uint32_t destination : destinations) {
+            benchmark::DoNotOptimize(map.nextHop(room, destination));
+        }
+        room = (room * 7 + 1) % rooms;
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(BM_StationMapNextHop)->ArgName("width")->Arg(8)->Arg(128);
+
+// Finding the triggers for an event, as every turn, use and interaction does
+void BM_TriggerLookup(benchmark::State& state) {
+    const TriggerProgram& script = WorldData::builtin()->script;
+    const std::pair<TriggerEvent, uint32_t> events[] = {
+        {TriggerEvent::TURN, 0},
+        {TriggerEvent::USE, Names::KEYCARD},
+        {TriggerEvent::INTERACT, Names::HACK_TERMINAL},
+        {TriggerEvent::INTERACT, Symbols::interactions().intern("examine terminal")}
+    };
+    for (auto _ : state) {
+        for (const auto& event : events) {
+            auto range = script.on(event.first, event.second);
+            benchmark::DoNotOptimize(range.second - range.first);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_TriggerLookup);
+
+// One whole winning session from the scripted playthrough, headless and
+// with its output discarded
+void BM_HeadlessPlaythrough(benchmark::State& state) {
+    std::ifstream file(SPACE_DYSTOPIA_SCRIPT);
+    if (!file) {
+        state.SkipWithError("cannot open " SPACE_DYSTOPIA_SCRIPT);
+        return;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string script = contents.str();
+    auto world = WorldData::builtin();
+
+    GameOptions options;
+    options.headless = true;
+    options.seed = 7;
+    for (auto _ : state) {
+        std::istringstream input(script);
+        NullStream output;
+        Game game(input, output, options, world);
+        game.run();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeadlessPlaythrough);
+
+}
+
+BENCHMARK_MAIN();
@@ -164,7 +164,11 @@ private:
     void typewriterEffect(const std::string& text, int delay_ms = 30) {
         for (char c : text) {
             std::cout << c << std::flush;
+#ifndef SPACE_DYSTOPIA_HEADLESS
             std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+#else
+            (void)delay_ms;
+#endif
         }
         std::cout << std::endl;
     }
@@ -18,7 +18,11 @@
 void typewriterEffect(const std::string& text, int delayMs = 30) {
     for (char c : text) {
         std::cout << c << std::flush;
+#ifndef SPACE_DYSTOPIA_HEADLESS
         std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+#else
+        (void)delayMs;
+#endif
     }
     std::cout << std::endl;
 }
@@ -10,603 +10,4625 @@
 #include <sstream>
 #include <random>
 #include <algorithm>
+#include <numeric>
 #include <functional>
 #include <iomanip>
 #include <set>
 #include <queue>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cctype>
+#include <sys/ioctl.h>
+#include <iterator>
+#include <bitset>
+#include <shared_mutex>
+#include <unordered_map>
+#include <new>
+#include <type_traits>
+#include <cmath>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+class TypewriterBuffer;
+
+// One thread animates the typewriter text of every session. Each frame it
+// writes whatever characters have become due as a single batch per buffer.
+class TypewriterScheduler {
+private:
+    std::vector<TypewriterBuffer*> buffers;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> hasWork;
+    bool stopping;
+    std::thread worker;
 
-void typewriterEffect(const std::string& text, int delayMs = 30) {
-    for (char c : text) {
-        std::cout << c << std::flush;
-        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
-    }
-    std::cout << std::endl;
-}
+    TypewriterScheduler() : hasWork(false), stopping(false), worker(&TypewriterScheduler::loop, this) {}
 
-// Template class for handling game statistics
-template<typename T>
-class Stat {
-private:
-    T current;
-    T maximum;
-    std::string name;
+    void loop();
 
 public:
-    Stat(const std::string& statName, T initial) 
-        : current(initial), maximum(initial), name(statName) {}
+    static constexpr std::chrono::milliseconds frame{16};
 
-    T getCurrent() const { return current; }
-    T getMaximum() const { return maximum; }
-    std::string getName() const { return name; }
+    ~TypewriterScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        worker.join();
+    }
 
-    void modify(T amount) {
-        current = std::min(maximum, current + amount);
-        current = std::max(T(0), current);
+    static TypewriterScheduler& instance() {
+        static TypewriterScheduler scheduler;
+        return scheduler;
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const Stat<T>& stat) {
-        os << stat.name << ": " << stat.current << "/" << stat.maximum;
-        return os;
+    void add(TypewriterBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(buffer);
     }
-};
 
-// ANSI escape codes for colors and formatting
-namespace AnsiArt {
-    const std::string RESET = "\033[0m";
-    const std::string RED = "\033[31m";
-    const std::string GREEN = "\033[32m";
-    const std::string BLUE = "\033[34m";
-    const std::string YELLOW = "\033[33m";
-    const std::string CLEAR_SCREEN = "\033[2J\033[H";
+    void remove(TypewriterBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.erase(std::remove(buffers.begin(), buffers.end(), buffer), buffers.end());
+    }
 
-    // Template function for centering text
-    template<typename T>
-    void printCentered(const T& text, int width = 80) {
-        std::string str = std::string(text);
-        int padding = (width - str.length()) / 2;
-        std::cout << std::string(padding, ' ') << str << std::endl;
+    void wake() {
+        hasWork = true;
+        wakeup.notify_one();
     }
+};
 
-    class AsciiArt {
-    public:
-        static void drawSpacestation() {
-            std::cout << R"(
-     _____
-    /=====/\
-   /=====/  \
-  /=====/    \
- /=====/      \
-(=================)
- \====/        /
-  \==/        /
-   \/________/
-)" << std::endl;
+// Stream buffer that queues a session's output in order. Text written
+// between startTyping() and stopTyping() is revealed gradually by the
+// scheduler; plain writes go out as soon as the animation queued ahead of
+// them has finished. Writers never block.
+class TypewriterBuffer : public std::streambuf {
+private:
+    struct Segment {
+        std::string text;
+        int delayMs;
+        size_t shown;
+        std::chrono::steady_clock::time_point start;
+        // Still being written; the scheduler waits at its end for more
+        bool open;
+    };
+
+    std::streambuf* target;
+    std::deque<Segment> segments;
+    // The text of segments played out, kept for their capacity
+    std::vector<std::string> spare;
+    bool started;
+    std::mutex mutex;
+    std::condition_variable drained;
+
+    // Requires the lock to be held
+    std::string recycled() {
+        if (spare.empty()) {
+            return std::string();
         }
+        std::string text = std::move(spare.back());
+        spare.pop_back();
+        return text;
+    }
 
-        static void drawMonolith() {
-            std::cout << R"(
-    ____________
-   |            |
-   |            |
-   |            |
-   |            |
-   |            |
-   |            |
-   |            |
-   |____________|
-)" << std::endl;
+    // Requires the lock to be held
+    void retire(Segment& segment) {
+        if (spare.size() < 8) {
+            segment.text.clear();
+            spare.push_back(std::move(segment.text));
         }
-    };
-}
+    }
 
-template<typename T>
-class QuestObjective {
-private:
-    std::string description;
-    T target;
-    T current;
-    bool completed;
+    void append(const char* text, size_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (segments.empty()) {
+            target->sputn(text, length);
+            return;
+        }
+        Segment& last = segments.back();
+        if (last.open || last.delayMs <= 0) {
+            last.text.append(text, length);
+        } else {
+            segments.push_back({recycled(), 0, 0, {}, false});
+            segments.back().text.append(text, length);
+        }
+        TypewriterScheduler::instance().wake();
+    }
 
-public:
-    QuestObjective(const std::string& desc, T targetValue)
-        : description(desc), target(targetValue), current(T()), completed(false) {}
+    // Requires the lock to be held
+    void flushAll() {
+        for (auto& segment : segments) {
+            target->sputn(segment.text.data() + segment.shown, segment.text.size() - segment.shown);
+            retire(segment);
+        }
+        segments.clear();
+        started = false;
+        target->pubsync();
+        drained.notify_all();
+    }
 
-    void updateProgress(T value) {
-        current = value;
-        completed = (current >= target);
+protected:
+    int_type overflow(int_type ch) override {
+        if (ch != traits_type::eof()) {
+            char c = traits_type::to_char_type(ch);
+            append(&c, 1);
+        }
+        return traits_type::not_eof(ch);
     }
 
-    bool isCompleted() const { return completed; }
-    std::string getDescription() const { return description; }
-    T getProgress() const { return current; }
-    T getTarget() const { return target; }
-};
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        append(s, static_cast<size_t>(n));
+        return n;
+    }
 
-class Quest {
-private:
-    std::string name;
-    std::string description;
-    std::vector<std::shared_ptr<QuestObjective<int>>> objectives;
-    bool completed;
+    int sync() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (segments.empty()) {
+            target->pubsync();
+        }
+        return 0;
+    }
 
 public:
-    Quest(const std::string& n, const std::string& desc)
-        : name(n), description(desc), completed(false) {}
+    explicit TypewriterBuffer(std::streambuf* out) : target(out), started(false) {
+        TypewriterScheduler::instance().add(this);
+    }
 
-    void addObjective(const std::string& desc, int target) {
-        objectives.push_back(std::make_shared<QuestObjective<int>>(desc, target));
+    ~TypewriterBuffer() override {
+        TypewriterScheduler::instance().remove(this);
+        std::lock_guard<std::mutex> lock(mutex);
+        flushAll();
     }
 
-    void updateObjective(size_t index, int value) {
-        if (index < objectives.size()) {
-            objectives[index]->updateProgress(value);
-            checkCompletion();
+    // Whatever is written from now until stopTyping() is typed out at one
+    // character per delayMs, straight from the queue it is written into
+    void startTyping(int delayMs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        segments.push_back({recycled(), delayMs, 0, {}, true});
+    }
+
+    void stopTyping() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!segments.empty()) {
+            segments.back().open = false;
         }
+        TypewriterScheduler::instance().wake();
     }
 
-    bool isCompleted() const { return completed; }
-    std::string getName() const { return name; }
+    // Reveals everything still queued at once, e.g. when the player presses a key
+    void skip() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushAll();
+    }
 
-private:
-    void checkCompletion() {
-        completed = std::all_of(objectives.begin(), objectives.end(),
-            [](const auto& obj) { return obj->isCompleted(); });
+    // Blocks until the queued animation has played out
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return segments.empty(); });
+    }
+
+    // Called by the scheduler once per frame; returns true while text is pending
+    bool tick(std::chrono::steady_clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool wrote = false;
+        while (!segments.empty()) {
+            Segment& segment = segments.front();
+            if (!started) {
+                segment.start = now;
+                started = true;
+            }
+            size_t due = segment.text.size();
+            if (segment.delayMs > 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - segment.start);
+                due = std::min(due, static_cast<size_t>(elapsed.count() / segment.delayMs) + 1);
+            }
+            if (due > segment.shown) {
+                target->sputn(segment.text.data() + segment.shown, due - segment.shown);
+                segment.shown = due;
+                wrote = true;
+            }
+            if (segment.shown < segment.text.size() || segment.open) {
+                break;
+            }
+            retire(segment);
+            segments.pop_front();
+            started = false;
+        }
+        if (wrote) {
+            target->pubsync();
+        }
+        if (segments.empty()) {
+            drained.notify_all();
+            return false;
+        }
+        return true;
     }
 };
 
-// New Combat System demonstrating inheritance and polymorphism
-class CombatEntity {
-protected:
-    std::string name;
-    int health;
-    int attack;
-    int defense;
+inline void TypewriterScheduler::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        hasWork = false;
+        bool busy = false;
+        auto now = std::chrono::steady_clock::now();
+        for (auto* buffer : buffers) {
+            busy = buffer->tick(now) || busy;
+        }
+        if (busy) {
+            wakeup.wait_for(lock, frame, [this] { return stopping; });
+        } else {
+            wakeup.wait(lock, [this] { return stopping || hasWork.load(); });
+        }
+    }
+}
+
+// Everything printed to the stream while a TypedLine is alive is one line of
+// typewriter text. Streams backed by a TypewriterBuffer animate it without
+// blocking; on any other stream, or with a delay of 0, it is printed at once.
+class TypedLine {
+private:
+    std::ostream& out;
+    TypewriterBuffer* animated;
 
 public:
-    CombatEntity(const std::string& n, int h, int a, int d)
-        : name(n), health(h), attack(a), defense(d) {}
-    
-    virtual ~CombatEntity() = default;
-    virtual int calculateDamage() const = 0;
-    virtual void takeDamage(int damage) {
-        health = std::max(0, health - std::max(0, damage - defense));
+    TypedLine(std::ostream& stream, int delayMs)
+        : out(stream), animated(delayMs > 0 ? dynamic_cast<TypewriterBuffer*>(stream.rdbuf()) : nullptr) {
+        if (animated) {
+            out.flush();
+            animated->startTyping(delayMs);
+        }
     }
 
-    bool isAlive() const { return health > 0; }
-    std::string getName() const { return name; }
-    int getHealth() const { return health; }
+    ~TypedLine() {
+        out << '\n';
+        if (animated) {
+            animated->stopTyping();
+        }
+    }
+
+    TypedLine(const TypedLine&) = delete;
+    TypedLine& operator=(const TypedLine&) = delete;
 };
 
-// Enhanced Player class with combat capabilities
-class CombatPlayer : public CombatEntity {
+void typewriterEffect(std::ostream& out, std::string_view text, int delayMs = 30) {
+    TypedLine line(out, delayMs);
+    out << text;
+}
+
+// Seedable xoshiro256** generator. Cheap to construct and to draw from, so
+// every Game owns one and combats can be replayed from a recorded seed.
+class Rng {
 private:
-    int level;
-    int experience;
-    std::vector<std::string> abilities;
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
 
 public:
-    CombatPlayer(const std::string& n)
-        : CombatEntity(n, 100, 15, 5), level(1), experience(0) {
-        abilities = {"Quick Attack", "Defensive Stance"};
+    using result_type = uint64_t;
+
+    explicit Rng(uint64_t seed = 0) { reseed(seed); }
+
+    // Expands the seed with splitmix64 so that nearby seeds give unrelated streams
+    void reseed(uint64_t seed) {
+        for (auto& word : state) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
     }
 
-    int calculateDamage() const override {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(-2, 2);
-        return attack + dis(gen);
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
     }
 
-    void gainExperience(int exp) {
-        experience += exp;
-        if (experience >= level * 100) {
-            levelUp();
-        }
+    // Uniform integer in [low, high]
+    int range(int low, int high) {
+        uint64_t span = static_cast<uint64_t>(high - low) + 1;
+        return low + static_cast<int>((static_cast<unsigned __int128>(next()) * span) >> 64);
     }
 
-private:
-    void levelUp() {
-        level++;
-        health += 10;
-        attack += 5;
-        defense += 3;
-        experience = 0;
-        std::cout << "\nLevel Up! Now level " << level << std::endl;
-        std::cout << "Health +" << 10 << std::endl;
-        std::cout << "Attack +" << 5 << std::endl;
-        std::cout << "Defense +" << 3 << std::endl;
+    // True with the given probability
+    bool chance(double probability) {
+        return static_cast<double>(next() >> 11) * 0x1.0p-53 < probability;
     }
+
+    // Raw generator state, so a saved session continues the same stream
+    void saveState(uint64_t words[4]) const { std::memcpy(words, state, sizeof(state)); }
+    void loadState(const uint64_t words[4]) { std::memcpy(state, words, sizeof(state)); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+    result_type operator()() { return next(); }
 };
 
-// New Enemy class demonstrating inheritance
-class Enemy : public CombatEntity {
+// Interns names into small dense integer IDs so that hot-path checks are
+// integer compares instead of string compares. Interning takes a lock and
+// normally happens while content is loaded; lookups by ID are cheap.
+class SymbolTable {
 private:
-    std::string type;
-    std::vector<std::string> dropItems;
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::deque<std::string> names;
+    size_t capacity;
 
 public:
-    Enemy(const std::string& n, const std::string& t, int h, int a, int d)
-        : CombatEntity(n, h, a, d), type(t) {}
+    explicit SymbolTable(size_t maxSymbols = std::numeric_limits<uint32_t>::max())
+        : capacity(maxSymbols) {}
+
+    uint32_t intern(std::string_view name) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = ids.find(name);
+            if (it != ids.end()) {
+                return it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        if (names.size() >= capacity) {
+            throw std::length_error("Too many symbols interning '" + std::string(name) + "'");
+        }
+        names.emplace_back(name);
+        uint32_t id = static_cast<uint32_t>(names.size() - 1);
+        ids.emplace(names.back(), id);
+        return id;
+    }
 
-    int calculateDamage() const override {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(-1, 1);
-        return attack + dis(gen);
+    // Looks a name up without interning it
+    std::optional<uint32_t> find(std::string_view name) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = ids.find(name);
+        if (it == ids.end()) {
+            return std::nullopt;
+        }
+        return it->second;
     }
 
-    void addDropItem(const std::string& item) {
-        dropItems.push_back(item);
+    std::string name(uint32_t id) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return id < names.size() ? names[id] : std::string();
     }
 
-    std::vector<std::string> getDrops() const {
-        return dropItems;
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return names.size();
     }
 };
 
-// Abstract base class demonstrating polymorphism
-class GameObject {
-protected:
-    std::string name;
-    std::string description;
+using FlagId = uint32_t;
+using ItemId = uint32_t;
+using InteractionId = uint32_t;
 
-public:
-    // Default constructor
-    GameObject() : name("Unknown"), description("No description") {}
-    
-    // Parameterized constructor
-    GameObject(const std::string& n, const std::string& desc) 
-        : name(n), description(desc) {}
-    
-    // Copy constructor
-    GameObject(const GameObject& other) 
-        : name(other.name), description(other.description) {}
-    
-    // Virtual destructor
-    virtual ~GameObject() = default;
+// Quest flags live in a fixed-width bitset, so their table is bounded
+constexpr size_t MAX_QUEST_FLAGS = 256;
 
-    // Pure virtual function demonstrating polymorphism
-    virtual void display() const = 0;
-    virtual void update() {}
+namespace Symbols {
+    inline SymbolTable& flags() {
+        static SymbolTable table(MAX_QUEST_FLAGS);
+        return table;
+    }
 
-    // Getters
-    std::string getName() const { return name; }
-    std::string getDescription() const { return description; }
-};
+    inline SymbolTable& items() {
+        static SymbolTable table;
+        return table;
+    }
 
-// Item class demonstrating inheritance
-class Item : public GameObject {
-private:
-    bool isUsable;
-    bool isPickable;
-    bool isAvailable;
-    std::function<void()> useEffect;
-    std::string useDescription;
+    inline SymbolTable& interactions() {
+        static SymbolTable table;
+        return table;
+    }
+}
 
-public:
-    Item(const std::string& n, const std::string& desc, bool usable = false, bool pickable = true) 
-        : GameObject(n, desc), isUsable(usable), isPickable(pickable), isAvailable(false), useDescription("No specific use instructions.") {}
+// Names the game logic refers to directly, interned once at startup
+namespace Names {
+    const FlagId READ_CLASSIFIED_INFO = Symbols::flags().intern("read_classified_info");
+    const FlagId TERMINAL_ACCESS_GRANTED = Symbols::flags().intern("terminal_access_granted");
+    const FlagId TERMINAL_HACKED = Symbols::flags().intern("terminal_hacked");
+    const FlagId SECURITY_DEFEATED = Symbols::flags().intern("security_defeated");
+    const FlagId SPACESUIT_EQUIPPED = Symbols::flags().intern("spacesuit_equipped");
+    const FlagId AIRLOCK_ESCAPED = Symbols::flags().intern("airlock_escaped");
+    const FlagId TOUCHED_MONOLITH = Symbols::flags().intern("touched_monolith");
+
+    const ItemId DATAPAD = Symbols::items().intern("Datapad");
+    const ItemId KEYCARD = Symbols::items().intern("Keycard");
+    const ItemId SPACESUIT = Symbols::items().intern("Spacesuit");
+    const ItemId EMP_DEVICE = Symbols::items().intern("EMP Device");
+
+    const InteractionId HACK_TERMINAL = Symbols::interactions().intern("hack terminal");
+}
 
-    void setUseEffect(std::function<void()> effect, const std::string& useDesc) {
-        useEffect = effect;
-        useDescription = useDesc;
-        isUsable = true;
-    }
+// Bump allocator owning every object created through it. Objects are never
+// freed one by one; the arena runs their destructors and releases its
+// blocks in one step when it is destroyed. Handles into it are plain
+// non-owning pointers. Not thread-safe: each session owns its own arena.
+class Arena {
+private:
+    struct Finalizer {
+        void (*destroy)(void*);
+        void* object;
+    };
 
-    void makeAvailable() {
-        isAvailable = true;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<Finalizer> finalizers;
+    char* cursor;
+    char* limit;
+    size_t blockSize;
+    size_t used;
+
+    void* allocate(size_t size, size_t alignment) {
+        auto address = reinterpret_cast<uintptr_t>(cursor);
+        size_t padding = (alignment - address % alignment) % alignment;
+        if (cursor == nullptr || padding + size > static_cast<size_t>(limit - cursor)) {
+            size_t bytes = std::max(blockSize, size + alignment);
+            blocks.emplace_back(new char[bytes]);
+            cursor = blocks.back().get();
+            limit = cursor + bytes;
+            address = reinterpret_cast<uintptr_t>(cursor);
+            padding = (alignment - address % alignment) % alignment;
+        }
+        char* result = cursor + padding;
+        cursor = result + size;
+        used += size;
+        return result;
     }
 
-    bool canUse() const { return isUsable; }
-    bool canPickup() const { return isPickable; }
-    std::string getUseDescription() const { return useDescription; }
-    
-    void use() {
-        if (isUsable && useEffect) {
-            useEffect();
+public:
+    explicit Arena(size_t bytesPerBlock = 16 * 1024)
+        : cursor(nullptr), limit(nullptr), blockSize(bytesPerBlock), used(0) {}
+
+    ~Arena() {
+        for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it) {
+            it->destroy(it->object);
         }
     }
 
-void display() const override {
-        std::cout << AnsiArt::YELLOW << "Item: " << name << AnsiArt::RESET << std::endl;
-        std::cout << description << std::endl;
-        if (isAvailable) {
-            if (isUsable) {
-                std::cout << "Usage: " << useDescription << std::endl;
-            }
-            if (isPickable) {
-                std::cout << "(Can be picked up)" << std::endl;
-            }
-        } else {
-            std::cout << "(Item not yet available)" << std::endl;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            finalizers.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, object});
         }
+        return object;
     }
+
+    size_t bytesUsed() const { return used; }
 };
 
-class Character : public GameObject {
-protected:
-    Stat<int> health;
-    Stat<int> energy;
-    std::vector<std::shared_ptr<Item>> inventory;
+// Every message the game itself prints, as opposed to world content. Each
+// has an ID for the code and a key for text sources; {0}..{9} in its text
+// stand for its arguments. The English wording is built in.
+namespace Text {
+    enum Id : uint32_t {
+        TITLE, FAREWELL, FAREWELL_LINE, OPENING, WELCOME,
+        NAME_PROMPT, RESUMING,
+        PLAYER_NAME, STAT, STAT_HEALTH, STAT_ENERGY, STAT_ATTACK, STAT_DEFENSE, STAT_VARIANCE,
+        PLAYER_DESCRIPTION, PLAYER_EXPERIENCE, PLAYER_STEPS, PLAYER_ITEMS,
+        INVENTORY, INVENTORY_EMPTY, LIST_ENTRY, GAINED_EXPERIENCE,
+        ITEM_NAME, ITEM_USAGE, ITEM_PICKABLE, ITEM_PENDING,
+        TERMINAL_LOCKED, NOTHING_HAPPENS,
+        LOCATION, PATROLLING, ALSO_HERE, ALSO_HERE_MORE, YOU_SEE, ITEM_ENTRY, POSSIBLE_INTERACTIONS,
+        PATROL_LEAVES, PATROL_ARRIVES,
+        MENU, MENU_PROMPT, INVALID_CHOICE, PRESS_ENTER,
+        AVAILABLE_LOCATIONS, NUMBERED_ENTRY, LOCATION_PROMPT, NO_ROUTE, ROUTE, ROUTE_STEP,
+        AVAILABLE_INTERACTIONS, INTERACTION_PROMPT, NO_INTERACTIONS,
+        NO_ITEMS, AVAILABLE_ITEMS, NUMBERED_ITEM, PICKUP_PROMPT,
+        NOT_AVAILABLE, TAKEN_FIRST, PICKED_UP, USING_ITEM,
+        STATUS_REPORT, STATUS_TERMINAL, STATUS_SECURITY, STATUS_ESCAPED, YES, NO,
+        COMBAT_START, ATTACK_MENU, EMP_DEPLOYED, NORMAL_ATTACK, NO_EMP,
+        PLAYER_DAMAGE, ENEMY_DEFEATED, ENEMY_DAMAGE, PLAYER_HEALTH, ENEMY_HEALTH, PLAYER_DEFEATED,
+        VICTORY, FINAL_STATISTICS, LOCATIONS_EXPLORED, SESSION_SEED,
+        ERROR,
+        COUNT
+    };
 
+    struct Message {
+        std::string_view key;
+        std::string_view english;
+    };
 
-public:
-    Character(const std::string& n, const std::string& desc, int h, int e) 
-        : GameObject(n, desc), health("Health", h), energy("Energy", e) {}
+    // In Id order
+    constexpr Message MESSAGES[] = {
+        {"title", "SPACE DYSTOPIA: THE LAST FRONTIER"},
+        {"farewell", "BYEEEEEE!"},
+        {"farewell.line", "{0}, will meet again soon."},
+        {"opening", "You are {0}, a maintenance worker on Europa Station."},
+        {"welcome", "\nWelcome to Space Station Europa. Your mission: Escape and reveal the truth."},
+        {"name.prompt", "\nEnter your name: "},
+        {"resuming", "\nResuming the saved session of {0}."},
+        {"player.name", "Name: {0}"},
+        {"stat", "{0}: {1}/{2}"},
+        {"stat.health", "Health"},
+        {"stat.energy", "Energy"},
+        {"stat.attack", "Attack"},
+        {"stat.defense", "Defense"},
+        {"stat.variance", "Variance"},
+        {"player.description", "Description: {0}"},
+        {"player.experience", "\nExperience: {0}"},
+        {"player.steps", "Total steps taken: {0}"},
+        {"player.items", "Items collected: {0}"},
+        {"inventory", "\nInventory:"},
+        {"inventory.empty", "Empty"},
+        {"list.entry", "- {0}"},
+        {"experience.gained", "Gained {0} experience!"},
+        {"item.name", "Item: {0}"},
+        {"item.usage", "Usage: {0}"},
+        {"item.pickable", "(Can be picked up)"},
+        {"item.pending", "(Item not yet available)"},
+        {"terminal.locked", "The terminal is locked. You need a keycard to access it."},
+        {"nothing.happens", "Nothing interesting happens."},
+        {"location", "\nLocation: {0}"},
+        {"patrolling", "{0} is patrolling here."},
+        {"also.here", "Also here: {0}"},
+        {"also.here.more", ", {0}"},
+        {"you.see", "\nYou see:"},
+        {"item.entry", "- {0}: {1}"},
+        {"interactions.possible", "\nPossible interactions:"},
+        {"patrol.leaves", "\n{0} heads off towards {1}."},
+        {"patrol.arrives", "\n{0} comes in from {1}."},
+        {"menu", "\nOptions:\n1. Move to another location\n2. Interact with environment\n3. Pick up item\n"
+                 "4. Check inventory\n5. Check status\n6. Quit\n"},
+        {"menu.prompt", "\nEnter your choice (1-6): "},
+        {"choice.invalid", "Invalid choice."},
+        {"press.enter", "\nPress Enter to continue..."},
+        {"locations.available", "\nAvailable locations:"},
+        {"numbered.entry", "{0}. {1}"},
+        {"location.prompt", "Choose location (1-{0}): "},
+        {"route.none", "There is no way to reach {0} from here."},
+        {"route", "Route: {0}"},
+        {"route.step", " -> {0}"},
+        {"interactions.available", "\nAvailable interactions:"},
+        {"interaction.prompt", "Choose interaction: "},
+        {"interactions.none", "No interactions available here."},
+        {"items.none", "There are no items to pick up here."},
+        {"items.available", "\nAvailable items to pick up:"},
+        {"numbered.item", "{0}. {1}: {2}"},
+        {"pickup.prompt", "Choose item to pick up (1-{0}) or 0 to cancel: "},
+        {"item.unavailable", "This item is not yet available."},
+        {"item.taken", "Someone else got to the {0} first."},
+        {"item.picked", "Picked up {0}"},
+        {"item.using", "\nUsing Item {0}..."},
+        {"status", "\nStatus Report:"},
+        {"status.terminal", "Terminal Hacked: {0}"},
+        {"status.security", "Security Defeated: {0}"},
+        {"status.escaped", "Escaped: {0}"},
+        {"yes", "Yes"},
+        {"no", "No"},
+        {"combat.start", "\nCombat with {0} initiated!"},
+        {"combat.menu", "\n1. Attack\n2. Use EMP (if available)\n"},
+        {"combat.emp", "EMP deployed successfully!"},
+        {"combat.attack", "You do a Normal Attack"},
+        {"combat.no.emp", "You do not have an EMP! \n You do a Normal Attack"},
+        {"combat.dealt", "You deal {0} damage!"},
+        {"combat.won", "You defeated {0}!"},
+        {"combat.taken", "{0} deals {1} damage!"},
+        {"combat.health", "\nYour Health: {0}"},
+        {"combat.enemy.health", "{0}'s Health: {1}"},
+        {"combat.lost", "You have been defeated by {0}..."},
+        {"victory", "\nVICTORY!"},
+        {"statistics", "\n=== Final Statistics ==="},
+        {"statistics.explored", "Locations explored: {0}/{1}"},
+        {"statistics.seed", "Session seed: {0}"},
+        {"error", "Error: {0}"}
+    };
+    static_assert(std::size(MESSAGES) == COUNT, "one message per ID");
 
-    virtual void display() const override {
-        std::cout << AnsiArt::GREEN << "Name: " << name << AnsiArt::RESET << std::endl;
-        std::cout << health << std::endl;
-        std::cout << energy << std::endl;
-        std::cout << "Description: " << description << std::endl;
+    // The message with this key, for loading text tables
+    inline std::optional<Id> find(std::string_view key) {
+        for (uint32_t id = 0; id < COUNT; ++id) {
+            if (MESSAGES[id].key == key) {
+                return static_cast<Id>(id);
+            }
+        }
+        return std::nullopt;
     }
 
-    void takeDamage(int damage) {
-        try {
-            if (damage < 0) {
-                throw std::invalid_argument("Damage cannot be negative!");
+    // The highest argument a message's text refers to, or -1 for none
+    inline int highestArgument(std::string_view text) {
+        int highest = -1;
+        for (size_t at = text.find('{'); at != std::string_view::npos; at = text.find('{', at + 1)) {
+            if (at + 2 < text.size() && std::isdigit(static_cast<unsigned char>(text[at + 1])) && text[at + 2] == '}') {
+                highest = std::max(highest, text[at + 1] - '0');
             }
-            health.modify(-damage);
-        } catch (const std::exception& e) {
-            std::cerr << "Error in takeDamage: " << e.what() << std::endl;
         }
+        return highest;
     }
+}
 
-    void addItem(std::shared_ptr<Item> item) {
-        inventory.push_back(item);
+// One locale's wording of every message. The built-in table is the English
+// literals; a loaded one is a set of views into a compiled text file mapped
+// read-only, so any number of sessions share it and switching a session to
+// another table copies nothing. Messages a table leaves out stay English.
+class TextTable {
+private:
+    // Keeps the text the views point into alive
+    std::shared_ptr<const void> owner;
+    std::string_view localeName;
+    std::string_view messages[Text::COUNT];
+
+    static int streamSlot() {
+        static const int slot = std::ios_base::xalloc();
+        return slot;
     }
 
-    const std::vector<std::shared_ptr<Item>>& getInventory() const {
-        return inventory;
+public:
+    TextTable() : localeName("en") {
+        for (uint32_t id = 0; id < Text::COUNT; ++id) {
+            messages[id] = Text::MESSAGES[id].english;
+        }
     }
-};
 
-class Player : public Character {
-private:
-    int experience;
-    std::map<std::string, bool> questFlags;
-    std::map<std::string, std::shared_ptr<Item>> itemMap;
-    int totalSteps;
-    int itemsCollected;
+    static const std::shared_ptr<const TextTable>& builtin() {
+        static const auto english = std::make_shared<const TextTable>();
+        return english;
+    }
 
-public:
-    Player(const std::string& n) 
-        : Character(n, "A maintenance worker on Europa", 100, 100), 
-          experience(0), totalSteps(0), itemsCollected(0) {}
+    // Builds the table as views into a compiled text image
+    static std::shared_ptr<const TextTable> fromImage(std::shared_ptr<const void> owner,
+                                                      const char* data, size_t size);
+    // Maps a compiled text file, or compiles a text source in memory
+    static std::shared_ptr<const TextTable> load(const std::string& path);
 
-    void display() const override {
-        Character::display();
-        std::cout << "\nExperience: " << experience << std::endl;
-        std::cout << "Total steps taken: " << totalSteps << std::endl;
-        std::cout << "Items collected: " << itemsCollected << std::endl;
-        
-        std::cout << "\nInventory:" << std::endl;
-        if (inventory.empty()) {
-            std::cout << "Empty" << std::endl;
-        } else {
-            for (const auto& item : inventory) {
-                std::cout << "- " << item->getName() << std::endl;
-            }
-        }
+    std::string_view locale() const { return localeName; }
+    std::string_view operator[](Text::Id id) const { return messages[id]; }
 
+    // Messages printed to a stream are worded by the table it uses, English
+    // unless one is set. The stream only points at the table.
+    static void use(std::ios_base& stream, const TextTable* table) {
+        stream.pword(streamSlot()) = const_cast<TextTable*>(table);
     }
 
-    void incrementSteps() { totalSteps++; }
-    void incrementItemsCollected() { itemsCollected++; }
+    static const TextTable& of(std::ios_base& stream) {
+        const void* table = stream.pword(streamSlot());
+        return table ? *static_cast<const TextTable*>(table) : *builtin();
+    }
+};
 
-    void gainExperience(int exp) {
-        if (exp > 0) {
-            experience += exp;
-            std::cout << "Gained " << exp << " experience!" << std::endl;
+// Messages are expanded straight into the stream: the text between
+// placeholders is written as it is, and each argument where it is referred
+// to, so printing one builds no strings along the way.
+namespace Text {
+    // A message argument: text, or a number printed as the stream prints it
+    class Arg {
+    private:
+        enum class Kind : uint8_t { TEXT, SIGNED, UNSIGNED };
+        Kind kind;
+        std::string_view text;
+        int64_t value;
+        uint64_t unsignedValue;
+
+    public:
+        Arg() : kind(Kind::TEXT), value(0), unsignedValue(0) {}
+        Arg(std::string_view s) : kind(Kind::TEXT), text(s), value(0), unsignedValue(0) {}
+
+        template<typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+        Arg(T number) : kind(std::is_signed<T>::value ? Kind::SIGNED : Kind::UNSIGNED),
+                        value(static_cast<int64_t>(number)), unsignedValue(static_cast<uint64_t>(number)) {}
+
+        void write(std::ostream& out) const {
+            switch (kind) {
+                case Kind::TEXT: out.write(text.data(), static_cast<std::streamsize>(text.size())); break;
+                case Kind::SIGNED: out << value; break;
+                case Kind::UNSIGNED: out << unsignedValue; break;
+            }
         }
-    }
+    };
 
-    void setQuestFlag(const std::string& flag) {
-        questFlags[flag] = true;
+    // Placeholders past the last argument are printed as they are
+    inline void expand(std::ostream& out, std::string_view pattern, const Arg* args, size_t count) {
+        size_t written = 0;
+        for (size_t at = pattern.find('{'); at != std::string_view::npos; at = pattern.find('{', at + 1)) {
+            if (at + 2 < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[at + 1])) &&
+                pattern[at + 2] == '}' && static_cast<size_t>(pattern[at + 1] - '0') < count) {
+                out.write(pattern.data() + written, static_cast<std::streamsize>(at - written));
+                args[pattern[at + 1] - '0'].write(out);
+                written = at + 3;
+            }
+        }
+        out.write(pattern.data() + written, static_cast<std::streamsize>(pattern.size() - written));
     }
 
-    bool hasQuestFlag(const std::string& flag) const {
-        return questFlags.count(flag) > 0;
+    template<typename... Args>
+    void print(std::ostream& out, Id id, const Args&... args) {
+        const Arg list[] = {Arg(args)..., Arg()};
+        expand(out, TextTable::of(out)[id], list, sizeof...(Args));
     }
 
-    bool hasItem(const std::string& itemName) const {
-        return itemMap.count(itemName) > 0;
+    // Prints the message as a line of its own
+    template<typename... Args>
+    void line(std::ostream& out, Id id, const Args&... args) {
+        print(out, id, args...);
+        out << '\n';
     }
+}
 
-    void addItem(std::shared_ptr<Item> item) {
-        itemMap[item->getName()] = item;
-        inventory.push_back(item);
-    }
-};
+// Every stat an entity can have and how its value is clamped, described
+// once at compile time. Names live here rather than next to each value.
+namespace Stats {
+    enum Id : uint8_t { HEALTH, ENERGY, ATTACK, DEFENSE, VARIANCE, COUNT };
+
+    struct Rule {
+        std::string_view name;
+        int32_t minimum;
+        // Whether the current value is also held at or below the maximum
+        bool capped;
+        // World ticks per point regained while below the maximum; 0 for none
+        uint32_t regenTicks;
+    };
 
-class Location {
-private:
-    std::string name;
-    std::string description;
-    std::map<std::string, std::shared_ptr<Item>> itemMap;
-    std::vector<std::shared_ptr<Item>> items;
-    std::vector<std::string> availableInteractions;
+    constexpr Rule SCHEMA[COUNT] = {
+        {"Health", 0, true, 0},
+        {"Energy", 0, true, 5},
+        {"Attack", 0, false, 0},
+        {"Defense", 0, false, 0},
+        {"Variance", 0, false, 0}
+    };
+}
 
-public:
+// The values of every stat in the schema for one entity, packed together.
+// Trivially copyable, so copying, snapshotting or saving stats is one
+// memcpy. Unused stats are simply zero.
+struct StatBlock {
+    int32_t current[Stats::COUNT];
+    int32_t maximum[Stats::COUNT];
+
+    template<Stats::Id S>
+    static constexpr int32_t clamp(int32_t value, int32_t maximum) {
+        value = std::max(Stats::SCHEMA[S].minimum, value);
+        if constexpr (Stats::SCHEMA[S].capped) {
+            value = std::min(maximum, value);
+        }
+        return value;
+    }
 
-    std::map<std::string, std::string> interactions;
+    template<Stats::Id S> int32_t get() const { return current[S]; }
+    template<Stats::Id S> int32_t getMaximum() const { return maximum[S]; }
 
-    Location(const std::string& n, const std::string& desc) 
-        : name(n), description(desc) {}
+    template<Stats::Id S>
+    void set(int32_t value) { current[S] = clamp<S>(value, maximum[S]); }
 
-    void addInteraction(const std::string& key, const std::string& response) {
-        interactions[key] = response;
-        availableInteractions.push_back(key);
+    template<Stats::Id S>
+    void modify(int32_t amount) { set<S>(current[S] + amount); }
+
+    // Starts a stat out full at value
+    template<Stats::Id S>
+    void reset(int32_t value) {
+        maximum[S] = value;
+        current[S] = value;
     }
 
-    const std::vector<std::string>& getAvailableInteractions() const {
-        return availableInteractions;
+    // Raises the maximum and the current value together, as levelling does
+    template<Stats::Id S>
+    void grow(int32_t amount) {
+        maximum[S] += amount;
+        modify<S>(amount);
     }
 
-    std::shared_ptr<Item> getItemByName(const std::string& itemName) {
-        auto it = itemMap.find(itemName);
-        if (it != itemMap.end()) {
-            return it->second;
+    // Regains what every regenerating stat recovers as the world clock goes
+    // from one tick to another. Returns whether any is still short of its
+    // maximum.
+    bool regenerate(uint64_t from, uint64_t to) {
+        for (size_t s = 0; s < Stats::COUNT; ++s) {
+            uint32_t every = Stats::SCHEMA[s].regenTicks;
+            if (every != 0 && current[s] < maximum[s]) {
+                uint64_t gained = to / every - from / every;
+                current[s] = static_cast<int32_t>(std::min<uint64_t>(maximum[s], uint64_t(current[s]) + gained));
+            }
         }
-        return nullptr;
+        return recovering();
     }
 
-    void addItem(std::shared_ptr<Item> item) {
-        itemMap[item->getName()] = item;
-        items.push_back(item);
+    // Whether any regenerating stat is below its maximum
+    bool recovering() const {
+        for (size_t s = 0; s < Stats::COUNT; ++s) {
+            if (Stats::SCHEMA[s].regenTicks != 0 && current[s] < maximum[s]) {
+                return true;
+            }
+        }
+        return false;
     }
+};
+static_assert(std::is_trivially_copyable<StatBlock>::value, "stat blocks are copied as bytes");
+
+static_assert(Text::STAT_VARIANCE - Text::STAT_HEALTH + 1 == Stats::COUNT, "a stat name per stat");
+
+// Read-only view of one stat in a block, for display
+template<Stats::Id S>
+class Stat {
+private:
+    const StatBlock& block;
+
+public:
+    explicit Stat(const StatBlock& stats) : block(stats) {}
+
+    int32_t getCurrent() const { return block.get<S>(); }
+    int32_t getMaximum() const { return block.getMaximum<S>(); }
+    static constexpr std::string_view getName() { return Stats::SCHEMA[S].name; }
+    // The stat's name in messages; the stat names are in schema order
+    static constexpr Text::Id getLabel() { return static_cast<Text::Id>(Text::STAT_HEALTH + S); }
+
+    friend std::ostream& operator<<(std::ostream& os, const Stat& stat) {
+        Text::print(os, Text::STAT, TextTable::of(os)[getLabel()], stat.getCurrent(), stat.getMaximum());
+        return os;
+    }
+};
+
+// ANSI escape codes for colors and formatting
+namespace AnsiArt {
+    const std::string RESET = "\033[0m";
+    const std::string RED = "\033[31m";
+    const std::string GREEN = "\033[32m";
+    const std::string BLUE = "\033[34m";
+    const std::string YELLOW = "\033[33m";
+    const std::string CLEAR_SCREEN = "\033[2J\033[H";
+
+    // Template function for centering text; pads in place without building
+    // a temporary string
+    template<typename T>
+    void printCentered(std::ostream& out, const T& text, int width = 80) {
+        std::string_view str(text);
+        int padding = std::max(0, (width - static_cast<int>(str.length())) / 2);
+        std::fill_n(std::ostreambuf_iterator<char>(out), padding, ' ');
+        out << str << '\n';
+    }
+
+    class AsciiArt {
+    public:
+        static void drawSpacestation(std::ostream& out) {
+            out << R"(
+     _____
+    /=====/\
+   /=====/  \
+  /=====/    \
+ /=====/      \
+(=================)
+ \====/        /
+  \==/        /
+   \/________/
+)" << '\n';
+        }
+
+        static void drawMonolith(std::ostream& out) {
+            out << R"(
+    ____________
+   |            |
+   |            |
+   |            |
+   |            |
+   |            |
+   |            |
+   |            |
+   |____________|
+)" << '\n';
+        }
+    };
+}
+
+// Fixed-width quest flag store. Listeners subscribe to individual flags and
+// are called only when that flag actually changes, so nothing has to poll.
+class QuestFlags {
+public:
+    using Listener = std::function<void(FlagId)>;
+
+private:
+    std::bitset<MAX_QUEST_FLAGS> bits;
+    std::bitset<MAX_QUEST_FLAGS> watched;
+    std::unordered_map<FlagId, std::vector<Listener>> listeners;
+
+    void notify(FlagId flag) {
+        if (!watched.test(flag)) {
+            return;
+        }
+        for (const auto& listener : listeners[flag]) {
+            listener(flag);
+        }
+    }
+
+public:
+    bool test(FlagId flag) const { return bits.test(flag); }
+
+    void set(FlagId flag, bool value = true) {
+        if (bits.test(flag) == value) {
+            return;
+        }
+        bits.set(flag, value);
+        notify(flag);
+    }
+
+    void subscribe(FlagId flag, Listener listener) {
+        watched.set(flag);
+        listeners[flag].push_back(std::move(listener));
+    }
+
+    // Sets every flag to the given value, notifying only those that change
+    void assign(const std::bitset<MAX_QUEST_FLAGS>& values) {
+        for (FlagId flag = 0; flag < MAX_QUEST_FLAGS; ++flag) {
+            set(flag, values.test(flag));
+        }
+    }
+
+    size_t count() const { return bits.count(); }
+    const std::bitset<MAX_QUEST_FLAGS>& raw() const { return bits; }
+};
+
+template<typename T>
+class QuestObjective {
+private:
+    std::string description;
+    T target;
+    T current;
+    bool completed;
+
+public:
+    QuestObjective(const std::string& desc, T targetValue)
+        : description(desc), target(targetValue), current(T()), completed(false) {}
+
+    void updateProgress(T value) {
+        current = value;
+        completed = (current >= target);
+    }
+
+    bool isCompleted() const { return completed; }
+    std::string getDescription() const { return description; }
+    T getProgress() const { return current; }
+    T getTarget() const { return target; }
+};
+
+class Quest {
+private:
+    std::string name;
+    std::string description;
+    std::vector<QuestObjective<int>> objectives;
+    // Flags each objective needs; empty for objectives updated by hand
+    std::vector<std::vector<FlagId>> objectiveFlags;
+    bool completed;
+
+    void refreshObjective(size_t index, const QuestFlags& flags) {
+        const auto& required = objectiveFlags[index];
+        int done = static_cast<int>(std::count_if(required.begin(), required.end(),
+            [&flags](FlagId flag) { return flags.test(flag); }));
+        updateObjective(index, done);
+    }
+
+public:
+    Quest(const std::string& n, const std::string& desc)
+        : name(n), description(desc), completed(false) {}
+
+    void addObjective(const std::string& desc, int target) {
+        objectives.emplace_back(desc, target);
+        objectiveFlags.emplace_back();
+    }
+
+    // Objective that is complete once all of the given flags are set
+    void addFlagObjective(const std::string& desc, std::vector<FlagId> flags) {
+        objectives.emplace_back(desc, static_cast<int>(flags.size()));
+        objectiveFlags.push_back(std::move(flags));
+    }
+
+    // Subscribes the flag-driven objectives to the store; each one is
+    // recomputed only when one of its own flags changes. The quest must
+    // stay at the same address while the store is alive.
+    void track(QuestFlags& flags) {
+        for (size_t i = 0; i < objectiveFlags.size(); ++i) {
+            for (FlagId flag : objectiveFlags[i]) {
+                flags.subscribe(flag, [this, i, &flags](FlagId) { refreshObjective(i, flags); });
+            }
+            if (!objectiveFlags[i].empty()) {
+                refreshObjective(i, flags);
+            }
+        }
+    }
+
+    void updateObjective(size_t index, int value) {
+        if (index < objectives.size()) {
+            objectives[index].updateProgress(value);
+            checkCompletion();
+        }
+    }
+
+    bool isCompleted() const { return completed; }
+    std::string getName() const { return name; }
+
+    // Whether every flag-driven objective has caught up with the flags, and
+    // the quest is complete exactly when all of its objectives are
+    bool consistent(const QuestFlags& flags) const {
+        for (size_t i = 0; i < objectives.size(); ++i) {
+            const auto& required = objectiveFlags[i];
+            int done = static_cast<int>(std::count_if(required.begin(), required.end(),
+                [&flags](FlagId flag) { return flags.test(flag); }));
+            if (!required.empty() && objectives[i].getProgress() != done) {
+                return false;
+            }
+        }
+        return completed == std::all_of(objectives.begin(), objectives.end(),
+            [](const auto& obj) { return obj.isCompleted(); });
+    }
+
+private:
+    void checkCompletion() {
+        completed = std::all_of(objectives.begin(), objectives.end(),
+            [](const auto& obj) { return obj.isCompleted(); });
+    }
+};
+
+// New Combat System demonstrating inheritance and polymorphism
+namespace Combat {
+    // Health left after a hit: defense absorbs part of the damage and health
+    // never drops below zero. Branch-free so loops over it vectorise.
+    inline int mitigate(int health, int damage, int defense) {
+        int absorbed = damage - defense;
+        absorbed = absorbed > 0 ? absorbed : 0;
+        int remaining = health - absorbed;
+        return remaining > 0 ? remaining : 0;
+    }
+}
+
+// The player's starting stats and per-level gains, shared with the
+// balance simulator
+namespace PlayerStats {
+    constexpr int BASE_HEALTH = 100;
+    constexpr int BASE_ENERGY = 100;
+    constexpr int BASE_ATTACK = 15;
+    constexpr int BASE_DEFENSE = 5;
+    constexpr int ATTACK_VARIANCE = 2;
+    constexpr int LEVEL_HEALTH = 10;
+    constexpr int LEVEL_ATTACK = 5;
+    constexpr int LEVEL_DEFENSE = 3;
+
+    inline StatBlock atLevel(int level) {
+        StatBlock stats{};
+        int gained = std::max(0, level - 1);
+        stats.reset<Stats::HEALTH>(BASE_HEALTH + gained * LEVEL_HEALTH);
+        stats.reset<Stats::ENERGY>(BASE_ENERGY);
+        stats.reset<Stats::ATTACK>(BASE_ATTACK + gained * LEVEL_ATTACK);
+        stats.reset<Stats::DEFENSE>(BASE_DEFENSE + gained * LEVEL_DEFENSE);
+        stats.reset<Stats::VARIANCE>(ATTACK_VARIANCE);
+        return stats;
+    }
+}
+
+// Enemies' attack rolls land within +/- this of their attack
+constexpr int ENEMY_ATTACK_VARIANCE = 1;
+
+namespace Combat {
+    // One attack within a batch; rows index into a CombatTable
+    struct Strike {
+        uint32_t attacker;
+        uint32_t defender;
+        int multiplier;
+    };
+
+    // Combatants stored as structure-of-arrays, so a turn for many
+    // encounters is resolved with straight loops over contiguous columns
+    // instead of one virtual call per attack.
+    class CombatTable {
+    private:
+        // Scratch columns reused between batches
+        std::vector<int> rolled;
+        std::vector<int> absorbed;
+
+    public:
+        std::vector<int> health;
+        std::vector<int> attack;
+        std::vector<int> defense;
+        std::vector<int> variance;
+
+        uint32_t add(int h, int a, int d, int v) {
+            health.push_back(h);
+            attack.push_back(a);
+            defense.push_back(d);
+            variance.push_back(v);
+            return static_cast<uint32_t>(health.size() - 1);
+        }
+
+        uint32_t add(const StatBlock& stats) {
+            return add(stats.get<Stats::HEALTH>(), stats.get<Stats::ATTACK>(), stats.get<Stats::DEFENSE>(),
+                       stats.get<Stats::VARIANCE>());
+        }
+
+        size_t size() const { return health.size(); }
+        bool isAlive(uint32_t row) const { return health[row] > 0; }
+
+        void clear() {
+            health.clear();
+            attack.clear();
+            defense.clear();
+            variance.clear();
+        }
+
+        // Resolves a batch of strikes in one pass and writes the raw damage
+        // of each into dealt (0 when the attacker was already down). All
+        // strikes in a batch land simultaneously, and several strikes may
+        // hit the same defender.
+        void resolve(const Strike* strikes, size_t count, Rng& rng, int* dealt) {
+            rolled.resize(count);
+            absorbed.resize(count);
+
+            // Rolls draw from the generator in strike order, so a batch is
+            // reproducible from its seed
+            for (size_t i = 0; i < count; ++i) {
+                int v = variance[strikes[i].attacker];
+                rolled[i] = v > 0 ? rng.range(-v, v) : 0;
+            }
+
+            absorbDamage(strikes, count, dealt);
+
+            // Subtracting every hit and clamping once gives the same result
+            // as applying Combat::mitigate hit by hit
+            for (size_t i = 0; i < count; ++i) {
+                int& target = health[strikes[i].defender];
+                target -= absorbed[i];
+                target = target > 0 ? target : 0;
+            }
+        }
+
+    private:
+        // The damage kernel: raw damage and the part that gets through the
+        // defender's defense, computed branch-free for every strike
+        void absorbDamage(const Strike* strikes, size_t count, int* dealt) {
+            const int* healthColumn = health.data();
+            const int* attackColumn = attack.data();
+            const int* defenseColumn = defense.data();
+            const int* rolls = rolled.data();
+            int* through = absorbed.data();
+            for (size_t i = 0; i < count; ++i) {
+                int alive = healthColumn[strikes[i].attacker] > 0;
+                int raw = alive * (attackColumn[strikes[i].attacker] + rolls[i]) * strikes[i].multiplier;
+                int passed = raw - defenseColumn[strikes[i].defender];
+                dealt[i] = raw;
+                through[i] = passed > 0 ? passed : 0;
+            }
+        }
+    };
+}
+
+// Immutable definitions of world content. Every session's Items and
+// Locations point at the same definitions instead of copying their text;
+// the views stay valid for as long as the world that handed them out.
+struct ItemDef {
+    std::string_view name;
+    std::string_view description;
+    size_t location;
+    bool usable;
+    // Shown with the item; what using it does is up to the world's triggers
+    std::string_view usage = {};
+    // Interned from name by WorldData::finalize()
+    ItemId id = 0;
+};
+
+struct LocationDef {
+    std::string_view name;
+    std::string_view description;
+    // As authored
+    std::vector<std::pair<std::string_view, std::string_view>> interactions;
+    // Built by index(): one entry per distinct key, in order, a later
+    // response for the same key replacing the earlier one
+    std::vector<InteractionId> interactionKeys = {};
+    std::vector<std::string_view> interactionNames = {};
+    std::vector<std::string_view> interactionResponses = {};
+
+    void index() {
+        interactionKeys.clear();
+        interactionNames.clear();
+        interactionResponses.clear();
+        for (const auto& interaction : interactions) {
+            InteractionId id = Symbols::interactions().intern(interaction.first);
+            auto it = std::find(interactionKeys.begin(), interactionKeys.end(), id);
+            if (it != interactionKeys.end()) {
+                interactionResponses[it - interactionKeys.begin()] = interaction.second;
+                continue;
+            }
+            interactionKeys.push_back(id);
+            interactionNames.push_back(interaction.first);
+            interactionResponses.push_back(interaction.second);
+        }
+    }
+};
+
+// Abstract base class demonstrating polymorphism
+class GameObject {
+protected:
+    // Views of text that is either shared (world definitions, which outlive
+    // the session) or owned by this object through `text`
+    std::string_view name;
+    std::string_view description;
+    std::shared_ptr<const std::pair<std::string, std::string>> text;
+
+public:
+    // Default constructor
+    GameObject() : name("Unknown"), description("No description") {}
+    
+    // Parameterized constructor; keeps its own copy of the text
+    GameObject(const std::string& n, const std::string& desc)
+        : text(std::make_shared<const std::pair<std::string, std::string>>(n, desc)) {
+        name = text->first;
+        description = text->second;
+    }
+
+    // Shares text that someone else keeps alive
+    GameObject(std::string_view n, std::string_view desc, std::nullptr_t)
+        : name(n), description(desc) {}
+    
+    // Copy constructor; copies share the text
+    GameObject(const GameObject& other) 
+        : name(other.name), description(other.description), text(other.text) {}
+    
+    // Virtual destructor
+    virtual ~GameObject() = default;
+
+    // Pure virtual function demonstrating polymorphism
+    virtual void display(std::ostream& out) const = 0;
+
+    // Getters
+    std::string_view getName() const { return name; }
+    std::string_view getDescription() const { return description; }
+};
+
+// Item class demonstrating inheritance
+class Item : public GameObject {
+private:
+    ItemId id;
+    bool isUsable;
+    bool isPickable;
+    bool isAvailable;
+    std::string_view useDescription;
+
+public:
+    Item(const std::string& n, const std::string& desc, bool usable = false, bool pickable = true) 
+        : GameObject(n, desc), id(Symbols::items().intern(n)), isUsable(usable), isPickable(pickable),
+          isAvailable(false), useDescription("No specific use instructions.") {}
+
+    // A session's copy of a world item: only its availability is its own,
+    // the text stays with the definition
+    explicit Item(const ItemDef& def)
+        : GameObject(def.name, def.description, nullptr), id(def.id), isUsable(def.usable), isPickable(true),
+          isAvailable(false),
+          useDescription(def.usage.empty() ? std::string_view("No specific use instructions.") : def.usage) {}
+
+    ItemId getId() const { return id; }
+
+    void makeAvailable() {
+        isAvailable = true;
+    }
+
+    bool canUse() const { return isUsable; }
+    bool canPickup() const { return isPickable; }
+    std::string getUseDescription() const { return std::string(useDescription); }
+
+void display(std::ostream& out) const override {
+        out << AnsiArt::YELLOW;
+        Text::print(out, Text::ITEM_NAME, name);
+        out << AnsiArt::RESET << '\n';
+        out << description << '\n';
+        if (isAvailable) {
+            if (isUsable) {
+                Text::line(out, Text::ITEM_USAGE, useDescription);
+            }
+            if (isPickable) {
+                Text::line(out, Text::ITEM_PICKABLE);
+            }
+        } else {
+            Text::line(out, Text::ITEM_PENDING);
+        }
+    }
+};
+
+// Handle to an item held in an Inventory. It stays valid while the item
+// is held, whatever else comes and goes, and stops resolving once the item
+// is removed, even after its slot has been reused.
+struct ItemHandle {
+    uint32_t slot;
+    uint32_t generation;
+};
+
+// The items a room or a character holds: a slot map over a dense array of
+// item pointers. Inserting, removing, and looking up by handle or by ItemId
+// take constant time, and iteration walks the dense array without copying.
+// Removal moves the last item into the gap, so the order is the order of
+// insertion only until something is removed.
+class Inventory {
+private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    struct Slot {
+        // Position in items while held, else the next free slot
+        uint32_t dense;
+        // Bumped on removal, invalidating handles to the slot
+        uint32_t generation;
+    };
+
+    // One per distinct ItemId held: a slot holding an item with that id,
+    // and how many such items there are
+    struct Bucket {
+        ItemId id;
+        uint32_t slot;
+        uint32_t count;
+    };
+
+    std::vector<Item*> items;
+    // Slot of items[i]
+    std::vector<uint32_t> owners;
+    std::vector<Slot> slots;
+    uint32_t freeSlot = NONE;
+    // Open addressing with linear probing; id NONE marks an empty bucket
+    std::vector<Bucket> index;
+    size_t mask = 0;
+    size_t distinct = 0;
+
+    size_t home(ItemId id) const { return (id * 0x9E3779B1u) & mask; }
+
+    size_t probe(ItemId id) const {
+        size_t bucket = home(id);
+        while (index[bucket].id != id && index[bucket].id != NONE) {
+            bucket = (bucket + 1) & mask;
+        }
+        return bucket;
+    }
+
+    // Bucket holding id, or NONE
+    size_t lookup(ItemId id) const {
+        if (index.empty()) {
+            return NONE;
+        }
+        size_t bucket = probe(id);
+        return index[bucket].id == NONE ? NONE : bucket;
+    }
+
+    void grow() {
+        std::vector<Bucket> old(std::max<size_t>(8, index.size() * 2), Bucket{NONE, 0, 0});
+        old.swap(index);
+        mask = index.size() - 1;
+        for (const Bucket& bucket : old) {
+            if (bucket.id != NONE) {
+                index[probe(bucket.id)] = bucket;
+            }
+        }
+    }
+
+    void indexInsert(ItemId id, uint32_t slot) {
+        if ((distinct + 1) * 2 > index.size()) {
+            grow();
+        }
+        Bucket& bucket = index[probe(id)];
+        if (bucket.id == NONE) {
+            bucket = {id, slot, 0};
+            distinct++;
+        }
+        bucket.count++;
+    }
+
+    void indexErase(size_t hole, uint32_t slot) {
+        Bucket& bucket = index[hole];
+        const ItemId id = bucket.id;
+        if (--bucket.count > 0) {
+            // Another item with the same id is still held; point at it
+            if (bucket.slot == slot) {
+                for (size_t i = 0; i < items.size(); ++i) {
+                    if (owners[i] != slot && items[i]->getId() == id) {
+                        bucket.slot = owners[i];
+                        break;
+                    }
+                }
+            }
+            return;
+        }
+        // Backward-shift deletion keeps every probe sequence unbroken
+        for (size_t next = (hole + 1) & mask; index[next].id != NONE; next = (next + 1) & mask) {
+            size_t want = home(index[next].id);
+            bool stays = hole <= next ? (want > hole && want <= next) : (want > hole || want <= next);
+            if (!stays) {
+                index[hole] = index[next];
+                hole = next;
+            }
+        }
+        index[hole].id = NONE;
+        distinct--;
+    }
+
+    bool valid(ItemHandle handle) const {
+        return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation;
+    }
+
+    void erase(uint32_t slot, size_t bucket) {
+        uint32_t position = slots[slot].dense;
+        indexErase(bucket, slot);
+        items[position] = items.back();
+        owners[position] = owners.back();
+        slots[owners[position]].dense = position;
+        items.pop_back();
+        owners.pop_back();
+        slots[slot].generation++;
+        slots[slot].dense = freeSlot;
+        freeSlot = slot;
+    }
+
+public:
+    ItemHandle insert(Item* item) {
+        uint32_t slot;
+        if (freeSlot != NONE) {
+            slot = freeSlot;
+            freeSlot = slots[slot].dense;
+        } else {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back({0, 0});
+        }
+        slots[slot].dense = static_cast<uint32_t>(items.size());
+        items.push_back(item);
+        owners.push_back(slot);
+        indexInsert(item->getId(), slot);
+        return {slot, slots[slot].generation};
+    }
+
+    bool remove(ItemHandle handle) {
+        if (!valid(handle)) {
+            return false;
+        }
+        erase(handle.slot, probe(items[slots[handle.slot].dense]->getId()));
+        return true;
+    }
+
+    // Removes one item with this id, if any is held
+    bool remove(ItemId id) {
+        size_t bucket = lookup(id);
+        if (bucket == NONE) {
+            return false;
+        }
+        erase(index[bucket].slot, bucket);
+        return true;
+    }
+
+    void clear() {
+        for (uint32_t slot : owners) {
+            slots[slot].generation++;
+            slots[slot].dense = freeSlot;
+            freeSlot = slot;
+        }
+        items.clear();
+        owners.clear();
+        std::fill(index.begin(), index.end(), Bucket{NONE, 0, 0});
+        distinct = 0;
+    }
+
+    Item* get(ItemHandle handle) const {
+        return valid(handle) ? items[slots[handle.slot].dense] : nullptr;
+    }
+
+    // One held item with this id, or null
+    Item* find(ItemId id) const {
+        size_t bucket = lookup(id);
+        return bucket == NONE ? nullptr : items[slots[index[bucket].slot].dense];
+    }
+
+    bool contains(ItemId id) const { return lookup(id) != NONE; }
+
+    // The handle of the item at a position of the iteration order
+    ItemHandle handleAt(size_t position) const {
+        uint32_t slot = owners[position];
+        return {slot, slots[slot].generation};
+    }
+
+    // Whether the items, their slots and the id index agree with each other.
+    // Walks all of them; for invariant checks.
+    bool consistent() const {
+        if (owners.size() != items.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (owners[i] >= slots.size() || slots[owners[i]].dense != i) {
+                return false;
+            }
+        }
+        size_t buckets = 0;
+        size_t counted = 0;
+        for (size_t bucket = 0; bucket < index.size(); ++bucket) {
+            const Bucket& entry = index[bucket];
+            if (entry.id == NONE) {
+                continue;
+            }
+            buckets++;
+            counted += entry.count;
+            if (lookup(entry.id) != bucket || entry.slot >= slots.size()) {
+                return false;
+            }
+            uint32_t position = slots[entry.slot].dense;
+            if (position >= items.size() || owners[position] != entry.slot || items[position]->getId() != entry.id) {
+                return false;
+            }
+            auto held = std::count_if(items.begin(), items.end(),
+                                      [&entry](const Item* item) { return item->getId() == entry.id; });
+            if (static_cast<size_t>(held) != entry.count) {
+                return false;
+            }
+        }
+        return buckets == distinct && counted == items.size();
+    }
+
+    Item* operator[](size_t position) const { return items[position]; }
+    std::vector<Item*>::const_iterator begin() const { return items.begin(); }
+    std::vector<Item*>::const_iterator end() const { return items.end(); }
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+};
+
+using EntityId = uint32_t;
+
+// The characters of a session, the player and every enemy, as rows of dense
+// component arrays indexed by EntityId. Systems such as combat and saving
+// walk the arrays they need rather than a class hierarchy, and a fight works
+// on the very stat rows the rest of the game reads, so its outcome stays.
+class EntityStore {
+public:
+    enum Faction : uint8_t { PLAYER, HOSTILE };
+
+    struct Identity {
+        std::string name;
+        // Borrowed from the world or from literals
+        std::string_view kind;
+        std::string_view description;
+    };
+
+    struct Combatant {
+        Faction faction;
+        int32_t level;
+    };
+
+    std::vector<Identity> identity;
+    std::vector<StatBlock> stats;
+    std::vector<Combatant> combat;
+    std::vector<Inventory> inventory;
+
+    EntityId create(Identity who, const StatBlock& block, Combatant traits) {
+        identity.push_back(std::move(who));
+        stats.push_back(block);
+        combat.push_back(traits);
+        inventory.emplace_back();
+        return static_cast<EntityId>(identity.size() - 1);
+    }
+
+    EntityId createPlayer(const std::string& name) {
+        return create({name, "Human", "A maintenance worker on Europa"}, PlayerStats::atLevel(1), {PLAYER, 1});
+    }
+
+    EntityId createEnemy(std::string_view name, std::string_view kind, int health, int attack, int defense) {
+        StatBlock block{};
+        block.reset<Stats::HEALTH>(health);
+        block.reset<Stats::ATTACK>(attack);
+        block.reset<Stats::DEFENSE>(defense);
+        block.reset<Stats::VARIANCE>(ENEMY_ATTACK_VARIANCE);
+        return create({std::string(name), kind, {}}, block, {HOSTILE, 1});
+    }
+
+    size_t size() const { return identity.size(); }
+};
+
+// The player's own progress, over the player's row in the entity store
+class Player {
+private:
+    EntityStore& entities;
+    EntityId entity;
+    int experience;
+    QuestFlags questFlags;
+    int totalSteps;
+    int itemsCollected;
+
+public:
+    Player(EntityStore& store, EntityId id)
+        : entities(store), entity(id), experience(0), totalSteps(0), itemsCollected(0) {}
+
+    EntityId getEntity() const { return entity; }
+    const std::string& getName() const { return entities.identity[entity].name; }
+    Stat<Stats::HEALTH> getHealth() const { return Stat<Stats::HEALTH>(entities.stats[entity]); }
+    Stat<Stats::ENERGY> getEnergy() const { return Stat<Stats::ENERGY>(entities.stats[entity]); }
+
+    void display(std::ostream& out) const {
+        const auto& who = entities.identity[entity];
+        out << AnsiArt::GREEN;
+        Text::print(out, Text::PLAYER_NAME, who.name);
+        out << AnsiArt::RESET << '\n';
+        out << getHealth() << '\n';
+        out << getEnergy() << '\n';
+        Text::line(out, Text::PLAYER_DESCRIPTION, who.description);
+        Text::line(out, Text::PLAYER_EXPERIENCE, experience);
+        Text::line(out, Text::PLAYER_STEPS, totalSteps);
+        Text::line(out, Text::PLAYER_ITEMS, itemsCollected);
+        
+        Text::line(out, Text::INVENTORY);
+        const auto& inventory = getInventory();
+        if (inventory.empty()) {
+            Text::line(out, Text::INVENTORY_EMPTY);
+        } else {
+            for (const auto& item : inventory) {
+                Text::line(out, Text::LIST_ENTRY, item->getName());
+            }
+        }
+
+    }
+
+    void incrementSteps() { totalSteps++; }
+    void incrementItemsCollected() { itemsCollected++; }
+
+    int getExperience() const { return experience; }
+    int getTotalSteps() const { return totalSteps; }
+    int getItemsCollected() const { return itemsCollected; }
+
+    void setVitals(int h, int e) {
+        entities.stats[entity].set<Stats::HEALTH>(h);
+        entities.stats[entity].set<Stats::ENERGY>(e);
+    }
+
+    void setProgress(int exp, int steps, int collected) {
+        experience = exp;
+        totalSteps = steps;
+        itemsCollected = collected;
+    }
+
+    void gainExperience(int exp, std::ostream& out) {
+        if (exp > 0) {
+            experience += exp;
+            Text::line(out, Text::GAINED_EXPERIENCE, exp);
+        }
+    }
+
+    void setQuestFlag(FlagId flag) {
+        questFlags.set(flag);
+    }
+
+    bool hasQuestFlag(FlagId flag) const {
+        return questFlags.test(flag);
+    }
+
+    QuestFlags& getQuestFlags() { return questFlags; }
+    const QuestFlags& getQuestFlags() const { return questFlags; }
+
+    bool hasItem(ItemId id) const {
+        return entities.inventory[entity].contains(id);
+    }
+
+    // Lookups by name, for tools and scripts; game logic uses interned IDs
+    bool hasQuestFlag(std::string_view flag) const {
+        auto id = Symbols::flags().find(flag);
+        return id && hasQuestFlag(*id);
+    }
+
+    bool hasItem(std::string_view itemName) const {
+        auto id = Symbols::items().find(itemName);
+        return id && hasItem(*id);
+    }
+
+    const Inventory& getInventory() const {
+        return entities.inventory[entity];
+    }
+
+    ItemHandle addItem(Item* item) {
+        return entities.inventory[entity].insert(item);
+    }
+};
+
+class Location {
+private:
+    // Shared with every session, unless interactions were added to this
+    // room, in which case it has been copied into `own`
+    const LocationDef* def;
+    std::unique_ptr<LocationDef> own;
+    // Backs the text of interactions added with addInteraction()
+    std::deque<std::string> ownText;
+    Inventory items;
+
+public:
+    explicit Location(const LocationDef& shared) : def(&shared) {}
+
+    // A room of its own, for content built in code
+    Location(const std::string& n, const std::string& desc)
+        : def(nullptr), own(std::make_unique<LocationDef>()) {
+        ownText.push_back(n);
+        ownText.push_back(desc);
+        own->name = ownText[0];
+        own->description = ownText[1];
+        def = own.get();
+    }
+
+    void addInteraction(const std::string& key, const std::string& response) {
+        if (!own) {
+            own = std::make_unique<LocationDef>(*def);
+            def = own.get();
+        }
+        ownText.push_back(key);
+        std::string_view keyText = ownText.back();
+        ownText.push_back(response);
+        own->interactions.emplace_back(keyText, ownText.back());
+        own->index();
+    }
+
+    const std::vector<std::string_view>& getAvailableInteractions() const {
+        return def->interactionNames;
+    }
+
+    InteractionId getInteractionKey(size_t index) const {
+        return def->interactionKeys[index];
+    }
+
+    Item* getItem(ItemId id) const {
+        return items.find(id);
+    }
+
+    ItemHandle addItem(Item* item) {
+        return items.insert(item);
+    }
+
+    void clearItems() {
+        items.clear();
+    }
+
+    void removeItem(ItemId id) {
+        items.remove(id);
+    }
+
+    void removeItem(ItemHandle handle) {
+        items.remove(handle);
+    }
+
+    std::string_view getName() const { return def->name; }
+    std::string_view getDescription() const { return def->description; }
+    
+    std::string_view interact(InteractionId key, const Player* player,
+                              const TextTable& text = *TextTable::builtin()) const {
+        const auto& keys = def->interactionKeys;
+        auto it = std::find(keys.begin(), keys.end(), key);
+        if (it != keys.end()) {
+            if (key == Names::HACK_TERMINAL && !player->hasItem(Names::KEYCARD)) {
+                return text[Text::TERMINAL_LOCKED];
+            }
+            return def->interactionResponses[it - keys.begin()];
+        }
+        return text[Text::NOTHING_HAPPENS];
+    }
+    
+
+    const Inventory& getItems() const {
+        return items;
+    }
+};
+
+// Station layout as an undirected graph over location indices, stored in
+// compressed sparse row form: the exits of location i are
+// targets[offsets[i] .. offsets[i + 1]). Shortest routes are found by one
+// breadth-first search from the destination and cached per destination, so
+// the distance and next hop from anywhere towards a destination routed to
+// before are single loads. Routes are computed on first use, once, and are
+// safe to share between threads.
+class StationMap {
+public:
+    static constexpr uint32_t UNREACHABLE = std::numeric_limits<uint32_t>::max();
+
+    // Towards one destination, indexed by the location you stand in
+    struct Routes {
+        std::vector<uint32_t> distance;
+        std::vector<uint32_t> next;
+    };
+
+private:
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> targets;
+    std::unique_ptr<std::once_flag[]> routed;
+    std::unique_ptr<Routes[]> routes;
+
+    void route(uint32_t destination) const {
+        Routes& result = routes[destination];
+        result.distance.assign(size(), UNREACHABLE);
+        result.next.assign(size(), UNREACHABLE);
+        std::vector<uint32_t> frontier{destination};
+        result.distance[destination] = 0;
+        result.next[destination] = destination;
+        for (size_t head = 0; head < frontier.size(); ++head) {
+            uint32_t here = frontier[head];
+            for (uint32_t e = offsets[here]; e < offsets[here + 1]; ++e) {
+                uint32_t neighbour = targets[e];
+                if (result.distance[neighbour] == UNREACHABLE) {
+                    result.distance[neighbour] = result.distance[here] + 1;
+                    result.next[neighbour] = here;
+                    frontier.push_back(neighbour);
+                }
+            }
+        }
+    }
+
+public:
+    StationMap() = default;
+
+    StationMap(size_t locationCount, const std::vector<std::pair<uint32_t, uint32_t>>& exits)
+        : offsets(locationCount + 1, 0),
+          routed(std::make_unique<std::once_flag[]>(locationCount)),
+          routes(std::make_unique<Routes[]>(locationCount)) {
+        for (const auto& exit : exits) {
+            offsets[exit.first + 1]++;
+            offsets[exit.second + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        targets.resize(offsets.back());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (const auto& exit : exits) {
+            targets[fill[exit.first]++] = exit.second;
+            targets[fill[exit.second]++] = exit.first;
+        }
+    }
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    bool hasExits() const { return !targets.empty(); }
+
+    std::pair<const uint32_t*, const uint32_t*> exits(uint32_t location) const {
+        return {targets.data() + offsets[location], targets.data() + offsets[location + 1]};
+    }
+
+    const Routes& routesTo(uint32_t destination) const {
+        std::call_once(routed[destination], [this, destination] { route(destination); });
+        return routes[destination];
+    }
+
+    uint32_t distance(uint32_t from, uint32_t to) const { return routesTo(to).distance[from]; }
+    uint32_t nextHop(uint32_t from, uint32_t to) const { return routesTo(to).next[from]; }
+};
+
+// Content rules. When an event happens (an item is used, an interaction is
+// chosen, a turn ends, the world clock reaches a tick) every trigger
+// registered for it whose conditions all hold runs its actions in order.
+// Triggers are authored by name, as world content, and compiled once when
+// the world loads: names are resolved to ids, each trigger becomes a run of
+// flat instructions, and a table indexed by event and subject leads straight
+// to the triggers that can apply.
+enum class TriggerEvent : uint8_t { USE, INTERACT, TURN, TIMER };
+constexpr size_t TRIGGER_EVENTS = 4;
+
+enum class TriggerOp : uint8_t {
+    // Conditions
+    AT, FLAG, HAS,
+    // Actions
+    SAY, TYPE, SET_FLAG, XP, FIGHT, ESCAPE
+};
+constexpr size_t TRIGGER_OPS = 9;
+
+inline bool isCondition(TriggerOp op) { return op <= TriggerOp::HAS; }
+
+struct TriggerDef {
+    struct Step {
+        TriggerOp op;
+        bool negate;
+        // Location, flag, item or enemy name, text, or experience points
+        std::string_view arg;
+    };
+
+    TriggerEvent event;
+    // Item name for USE, interaction key for INTERACT, empty for TURN, the
+    // tick it goes off at for TIMER
+    std::string_view subject;
+    std::vector<Step> conditions;
+    std::vector<Step> actions;
+};
+
+// Parses a count authored as world content, such as experience points
+inline uint32_t parseCount(std::string_view text, const char* what) {
+    uint32_t count = 0;
+    for (char c : text) {
+        if (!std::isdigit(static_cast<unsigned char>(c)) || count > 1000000) {
+            throw std::runtime_error(std::string("Trigger ") + what + " must be a number, not '" +
+                                     std::string(text) + "'");
+        }
+        count = count * 10 + static_cast<uint32_t>(c - '0');
+    }
+    return count;
+}
+
+class TriggerProgram {
+public:
+    struct Instruction {
+        TriggerOp op;
+        bool negate;
+        // Resolved id or value; SAY and TYPE use the text instead
+        uint32_t arg;
+        std::string_view text;
+    };
+
+    // Instructions [begin, actions) are its conditions, [actions, end) its actions
+    struct Trigger {
+        uint32_t begin;
+        uint32_t actions;
+        uint32_t end;
+    };
+
+private:
+    std::vector<Instruction> code;
+    std::vector<Trigger> triggers;
+    // Trigger indices per event, in CSR form by subject id
+    std::vector<uint32_t> offsets[TRIGGER_EVENTS];
+    std::vector<uint32_t> order[TRIGGER_EVENTS];
+    // TIMER triggers as (tick, trigger index), soonest first
+    std::vector<std::pair<uint32_t, uint32_t>> timers;
+
+    static uint32_t subjectOf(const TriggerDef& def) {
+        switch (def.event) {
+            case TriggerEvent::USE: return Symbols::items().intern(def.subject);
+            case TriggerEvent::INTERACT: return Symbols::interactions().intern(def.subject);
+            default: return 0;
+        }
+    }
+
+public:
+    TriggerProgram() = default;
+
+    // resolve(step) returns the id or value a step's argument stands for
+    template<typename Resolve>
+    TriggerProgram(const std::vector<TriggerDef>& defs, Resolve resolve) {
+        std::vector<uint32_t> subjects;
+        for (const auto& def : defs) {
+            Trigger trigger;
+            trigger.begin = static_cast<uint32_t>(code.size());
+            for (const auto& step : def.conditions) {
+                code.push_back({step.op, step.negate, resolve(step), step.arg});
+            }
+            trigger.actions = static_cast<uint32_t>(code.size());
+            for (const auto& step : def.actions) {
+                code.push_back({step.op, step.negate, resolve(step), step.arg});
+            }
+            trigger.end = static_cast<uint32_t>(code.size());
+            triggers.push_back(trigger);
+            subjects.push_back(subjectOf(def));
+            if (def.event == TriggerEvent::TIMER) {
+                timers.emplace_back(parseCount(def.subject, "timer"), static_cast<uint32_t>(triggers.size() - 1));
+            }
+        }
+        std::stable_sort(timers.begin(), timers.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t event = 0; event < TRIGGER_EVENTS; ++event) {
+            uint32_t width = 0;
+            for (size_t i = 0; i < defs.size(); ++i) {
+                if (static_cast<size_t>(defs[i].event) == event) {
+                    width = std::max(width, subjects[i] + 1);
+                }
+            }
+            offsets[event].assign(width + 1, 0);
+            for (size_t i = 0; i < defs.size(); ++i) {
+                if (static_cast<size_t>(defs[i].event) == event) {
+                    offsets[event][subjects[i] + 1]++;
+                }
+            }
+            std::partial_sum(offsets[event].begin(), offsets[event].end(), offsets[event].begin());
+            order[event].resize(offsets[event].back());
+            std::vector<uint32_t> fill(offsets[event].begin(), offsets[event].end() - 1);
+            for (size_t i = 0; i < defs.size(); ++i) {
+                if (static_cast<size_t>(defs[i].event) == event) {
+                    order[event][fill[subjects[i]]++] = static_cast<uint32_t>(i);
+                }
+            }
+        }
+    }
+
+    // Indices of the triggers for an event on a subject, in authored order
+    std::pair<const uint32_t*, const uint32_t*> on(TriggerEvent event, uint32_t subject) const {
+        const auto& table = offsets[static_cast<size_t>(event)];
+        if (subject + 1 >= table.size()) {
+            return {nullptr, nullptr};
+        }
+        const uint32_t* base = order[static_cast<size_t>(event)].data();
+        return {base + table[subject], base + table[subject + 1]};
+    }
+
+    const std::vector<std::pair<uint32_t, uint32_t>>& timerTriggers() const { return timers; }
+
+    const Trigger& trigger(uint32_t index) const { return triggers[index]; }
+    const Instruction& at(uint32_t pc) const { return code[pc]; }
+    size_t size() const { return triggers.size(); }
+};
+
+// Static world content, built once and shared read-only by every session.
+// Each Game builds its own mutable Locations, Items and Enemies from it.
+// The text lives either in string literals (builtin) or in a memory-mapped
+// compiled world file (load), so the definitions only hold string views.
+struct WorldData {
+    using LocationDef = ::LocationDef;
+    using ItemDef = ::ItemDef;
+
+    struct EnemyDef {
+        std::string_view name;
+        std::string_view type;
+        int health;
+        int attack;
+        int defense;
+    };
+
+    // An enemy walking a round of locations, spending ticksPerRoom world
+    // ticks in each room on its way. It starts at the first waypoint and
+    // returns there after the last.
+    struct PatrolDef {
+        uint32_t enemy;
+        uint32_t ticksPerRoom;
+        std::vector<uint32_t> waypoints;
+    };
+
+    std::vector<LocationDef> locations;
+    std::vector<ItemDef> items;
+    std::vector<EnemyDef> enemies;
+    // Pairs of connected location indices; doors work both ways
+    std::vector<std::pair<uint32_t, uint32_t>> exits;
+    std::vector<PatrolDef> patrols;
+    std::vector<TriggerDef> triggers;
+    // Built from the above by finalize()
+    StationMap map;
+    TriggerProgram script;
+    std::unordered_map<std::string_view, uint32_t> locationIndex;
+    // Indices of the items each location starts with, in CSR form
+    std::vector<uint32_t> initialItemOffsets;
+    std::vector<uint32_t> initialItems;
+    // Keeps the memory behind the string views alive
+    std::shared_ptr<const void> storage;
+
+    void finalize() {
+        for (auto& location : locations) {
+            location.index();
+        }
+        for (auto& item : items) {
+            item.id = Symbols::items().intern(item.name);
+        }
+        map = StationMap(locations.size(), exits);
+        locationIndex.clear();
+        for (size_t i = 0; i < locations.size(); ++i) {
+            locationIndex.emplace(locations[i].name, static_cast<uint32_t>(i));
+        }
+        initialItemOffsets.assign(locations.size() + 1, 0);
+        for (const auto& item : items) {
+            initialItemOffsets[item.location + 1]++;
+        }
+        std::partial_sum(initialItemOffsets.begin(), initialItemOffsets.end(), initialItemOffsets.begin());
+        initialItems.resize(items.size());
+        std::vector<uint32_t> fill(initialItemOffsets.begin(), initialItemOffsets.end() - 1);
+        for (size_t i = 0; i < items.size(); ++i) {
+            initialItems[fill[items[i].location]++] = static_cast<uint32_t>(i);
+        }
+        script = TriggerProgram(triggers, [this](const TriggerDef::Step& step) { return resolve(step); });
+        for (const auto& trigger : triggers) {
+            for (const auto& step : trigger.actions) {
+                // A timer goes off between inputs, when nothing could answer a fight
+                if (trigger.event == TriggerEvent::TIMER &&
+                    (step.op == TriggerOp::FIGHT || step.op == TriggerOp::ESCAPE)) {
+                    throw std::runtime_error("Timer triggers cannot fight or escape");
+                }
+            }
+        }
+        for (const auto& patrol : patrols) {
+            if (patrol.enemy >= enemies.size() || patrol.ticksPerRoom == 0 || patrol.waypoints.empty()) {
+                throw std::runtime_error("Patrol is not a walk of some enemy");
+            }
+            for (size_t i = 0; i < patrol.waypoints.size(); ++i) {
+                uint32_t from = patrol.waypoints[i];
+                uint32_t to = patrol.waypoints[(i + 1) % patrol.waypoints.size()];
+                if (from >= locations.size() || to >= locations.size() ||
+                    (map.hasExits() && map.distance(from, to) == StationMap::UNREACHABLE)) {
+                    throw std::runtime_error("Patrol of " + std::string(enemies[patrol.enemy].name) +
+                                             " cannot walk its route");
+                }
+            }
+        }
+    }
+
+    uint32_t resolve(const TriggerDef::Step& step) const {
+        auto unknown = [&step](const char* what) {
+            return std::runtime_error(std::string("Trigger refers to unknown ") + what + " '" +
+                                      std::string(step.arg) + "'");
+        };
+        switch (step.op) {
+            case TriggerOp::AT: {
+                auto index = findLocation(step.arg);
+                if (!index) {
+                    throw unknown("location");
+                }
+                return *index;
+            }
+            case TriggerOp::FLAG:
+            case TriggerOp::SET_FLAG:
+                return Symbols::flags().intern(step.arg);
+            case TriggerOp::HAS:
+                return Symbols::items().intern(step.arg);
+            case TriggerOp::XP:
+                return parseCount(step.arg, "experience");
+            case TriggerOp::FIGHT:
+                for (size_t i = 0; i < enemies.size(); ++i) {
+                    if (enemies[i].name == step.arg) {
+                        return static_cast<uint32_t>(i);
+                    }
+                }
+                throw unknown("enemy");
+            default:
+                return 0;
+        }
+    }
+
+    std::vector<uint32_t> initialItemsOf(size_t location) const {
+        return std::vector<uint32_t>(initialItems.begin() + initialItemOffsets[location],
+                                     initialItems.begin() + initialItemOffsets[location + 1]);
+    }
+
+    std::optional<uint32_t> findLocation(std::string_view name) const {
+        auto it = locationIndex.find(name);
+        if (it == locationIndex.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    static std::shared_ptr<const WorldData> builtin() {
+        static const std::shared_ptr<const WorldData> world = [] {
+            auto w = std::make_shared<WorldData>();
+            w->locations = {
+                {"Maintenance Bay", "A sterile white room filled with repair equipment.", {
+                    {"examine workbench", "You find various repair tools and a hidden datapad."}
+                }},
+                {"Terminal Room", "A quiet room with a terminal. Red light pulses steadily.", {
+                    // Single hack terminal interaction
+                    {"hack terminal", "You begin hacking the terminal... Security has been alerted!"},
+                    {"examine terminal", "The terminal displays various system diagnostics."}
+                }},
+                {"Security Post", "A heavily guarded area with advanced security bots.", {
+                    {"examine security", "The security systems are active but might be vulnerable to EMPs."}
+                }},
+                {"Airlock", "The gateway between the station and the void of space.", {
+                    {"check airlock", "The airlock appears functional. A spacesuit would be required for EVA."},
+                    {"activate airlock", "The airlock cycles... This is your chance to escape!"}
+                }}
+            };
+            w->items = {
+                {"Datapad", "A tablet containing classified information", 0, true,
+                 "Access classified information about the mysterious signals"},
+                {"Keycard", "A security keycard", 1, true, "Use at terminals to gain access"},
+                {"EMP Device", "Can disable security systems", 2, true},
+                {"Spacesuit", "Required for space travel", 3, true, "Required for EVA activities"}
+            };
+            w->enemies = {
+                {"Security Bot", "Robot", 50, 10, 3},
+                {"Elite Guard Bot", "Robot", 75, 15, 5}
+            };
+            w->exits = {{0, 1}, {1, 2}, {2, 3}};
+            w->patrols = {{1, 40, {2, 3}}};
+            using Op = TriggerOp;
+            w->triggers = {
+                {TriggerEvent::USE, "Datapad", {}, {
+                    {Op::SAY, false, "You carefully read through the classified information..."},
+                    {Op::SAY, false, "The data reveals coordinates for a potentially habitable planet beyond Pluto."},
+                    {Op::SET_FLAG, false, "read_classified_info"},
+                    {Op::XP, false, "20"}
+                }},
+                {TriggerEvent::USE, "Keycard", {{Op::AT, false, "Terminal Room"}}, {
+                    {Op::SAY, false, "You swipe the keycard through the terminal..."},
+                    {Op::SET_FLAG, false, "terminal_access_granted"},
+                    {Op::XP, false, "15"}
+                }},
+                {TriggerEvent::USE, "Keycard", {{Op::AT, true, "Terminal Room"}}, {
+                    {Op::SAY, false, "There's nowhere to use the keycard here."}
+                }},
+                {TriggerEvent::USE, "Spacesuit", {{Op::AT, false, "Airlock"}}, {
+                    {Op::SAY, false, "You put on the spacesuit, checking all seals..."},
+                    {Op::SET_FLAG, false, "spacesuit_equipped"},
+                    {Op::XP, false, "10"}
+                }},
+                {TriggerEvent::USE, "Spacesuit", {{Op::AT, true, "Airlock"}}, {
+                    {Op::SAY, false, "You should wait until you're at the airlock."}
+                }},
+                {TriggerEvent::INTERACT, "hack terminal", {}, {
+                    {Op::SET_FLAG, false, "terminal_hacked"},
+                    {Op::FIGHT, false, "Security Bot"}
+                }},
+                {TriggerEvent::INTERACT, "activate airlock",
+                 {{Op::FLAG, false, "terminal_hacked"}, {Op::FLAG, false, "security_defeated"}}, {
+                    {Op::SET_FLAG, false, "airlock_escaped"},
+                    {Op::ESCAPE, false, ""},
+                    {Op::TYPE, false, "Congratulations! You've escaped and can now reveal the truth!"}
+                }},
+                {TriggerEvent::TURN, "", {
+                    {Op::AT, false, "Terminal Room"},
+                    {Op::FLAG, false, "terminal_access_granted"},
+                    {Op::FLAG, true, "security_defeated"}
+                }, {
+                    {Op::SAY, false, "\nA Security Bot has detected your presence!"},
+                    {Op::FIGHT, false, "Security Bot"}
+                }},
+                {TriggerEvent::TURN, "", {
+                    {Op::AT, false, "Airlock"},
+                    {Op::FLAG, false, "security_defeated"},
+                    {Op::FLAG, false, "spacesuit_equipped"}
+                }, {
+                    {Op::ESCAPE, false, ""},
+                    {Op::TYPE, false, "Congratulations! You've successfully escaped!"}
+                }},
+                {TriggerEvent::TIMER, "3000", {{Op::FLAG, true, "security_defeated"}}, {
+                    {Op::SAY, false, "\nStation announcement: lockdown sweep in progress. All personnel report to quarters."}
+                }}
+            };
+            w->finalize();
+            return w;
+        }();
+        return world;
+    }
+
+    static std::shared_ptr<const WorldData> fromImage(std::shared_ptr<const void> owner,
+                                                      const char* data, size_t size);
+    static std::shared_ptr<const WorldData> load(const std::string& path);
+};
+
+// Compiled world file layout (all integers little-endian uint32/int32):
+//   WorldHeader
+//   LocationRecord[locationCount]
+//   InteractionRecord[interactionCount]   grouped by location
+//   ItemRecord[itemCount]
+//   EnemyRecord[enemyCount]
+//   ExitRecord[exitCount]
+//   PatrolRecord[patrolCount]
+//   uint32_t waypoint[waypointCount]      each patrol's location indices in turn
+//   TriggerRecord[triggerCount]
+//   StepRecord[stepCount]                 each trigger's conditions, then its actions
+//   string pool (stringBytes bytes, referenced by offset/length)
+namespace WorldFormat {
+    const char MAGIC[4] = {'S', 'D', 'W', 'B'};
+    const uint32_t VERSION = 4;
+
+    struct StrRef { uint32_t offset; uint32_t length; };
+
+    struct WorldHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t locationCount;
+        uint32_t interactionCount;
+        uint32_t itemCount;
+        uint32_t enemyCount;
+        uint32_t exitCount;
+        uint32_t patrolCount;
+        uint32_t waypointCount;
+        uint32_t triggerCount;
+        uint32_t stepCount;
+        uint32_t stringBytes;
+    };
+
+    struct LocationRecord { StrRef name; StrRef description; uint32_t firstInteraction; uint32_t interactionCount; };
+    struct InteractionRecord { StrRef key; StrRef response; };
+    struct ItemRecord { StrRef name; StrRef description; uint32_t location; uint32_t usable; StrRef usage; };
+    struct EnemyRecord { StrRef name; StrRef type; int32_t health; int32_t attack; int32_t defense; };
+    struct ExitRecord { uint32_t from; uint32_t to; };
+    struct PatrolRecord { uint32_t enemy; uint32_t ticksPerRoom; uint32_t firstWaypoint; uint32_t waypointCount; };
+    struct TriggerRecord { uint32_t event; StrRef subject; uint32_t firstStep; uint32_t conditionCount; uint32_t actionCount; };
+    struct StepRecord { uint32_t op; uint32_t negate; StrRef arg; };
+
+    // Source spellings of TriggerEvent and TriggerOp, in enum order
+    const char* const EVENT_NAMES[TRIGGER_EVENTS] = {"use", "interact", "turn", "timer"};
+    const char* const OP_NAMES[TRIGGER_OPS] = {"at", "flag", "has", "say", "type", "flag", "xp", "fight", "escape"};
+
+    template<typename T>
+    void append(std::string& image, const T& record) {
+        image.append(reinterpret_cast<const char*>(&record), sizeof(T));
+    }
+
+    template<typename T>
+    T read(const char* data, size_t size, size_t& offset) {
+        if (offset + sizeof(T) > size) {
+            throw std::runtime_error("World file is truncated");
+        }
+        T record;
+        std::memcpy(&record, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return record;
+    }
+
+    // Splits "a | b | c" into trimmed fields
+    inline std::vector<std::string> splitFields(const std::string& line) {
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '|')) {
+            size_t begin = field.find_first_not_of(" \t");
+            size_t end = field.find_last_not_of(" \t\r");
+            fields.push_back(begin == std::string::npos ? "" : field.substr(begin, end - begin + 1));
+        }
+        return fields;
+    }
+
+    // Turns "\n" in trigger text into a line break
+    inline std::string unescape(const std::string& text) {
+        std::string result;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == 'n') {
+                result += '\n';
+                ++i;
+            } else {
+                result += text[i];
+            }
+        }
+        return result;
+    }
+
+    // Packs a text world definition into the binary image. Source lines:
+    //   location    | <name> | <description>
+    //   interaction | <key> | <response>                 (belongs to the last location)
+    //   item        | <name> | <description> [| usable [| <usage>]]
+    //                                                    (placed in the last location)
+    //   enemy       | <name> | <type> | <health> | <attack> | <defense>
+    //   exit        | <location name>                  (connects it with the last location)
+    //   patrol      | <enemy> | <ticks per room> | <location> [| <location> ...]
+    //                                                    (walks the locations round and round)
+    //   on          | use | <item>                     (starts a trigger)
+    //   on          | interact | <key>
+    //   on          | turn                             (after every turn)
+    //   on          | timer | <tick>                   (once, when the world clock gets there)
+    //   if          | [not] at | <location>            (conditions of the last trigger)
+    //   if          | [not] flag | <flag>
+    //   if          | [not] has | <item>
+    //   do          | say | <text>                     (actions of the last trigger)
+    //   do          | type | <text>                    (typed out; "\n" breaks a line)
+    //   do          | flag | <flag>
+    //   do          | xp | <points>
+    //   do          | fight | <enemy>
+    //   do          | escape
+    // Exits and patrols may name locations and enemies defined further down.
+    // Blank lines and lines starting with '#' are ignored.
+    inline std::string compile(std::istream& source) {
+        std::vector<LocationRecord> locations;
+        std::vector<InteractionRecord> interactions;
+        std::vector<ItemRecord> items;
+        std::vector<EnemyRecord> enemies;
+        std::vector<ExitRecord> exits;
+        std::vector<TriggerRecord> triggers;
+        // Per trigger, until they are laid out one after the other
+        std::vector<std::vector<StepRecord>> conditions;
+        std::vector<std::vector<StepRecord>> actions;
+        // Exit targets by name, resolved once every location is known
+        std::vector<std::pair<std::string, int>> exitTargets;
+        std::vector<PatrolRecord> patrols;
+        // Enemy and waypoint names of each patrol, with its line
+        std::vector<std::pair<std::vector<std::string>, int>> patrolNames;
+        std::unordered_map<std::string, uint32_t> locationNames;
+        std::unordered_map<std::string, uint32_t> enemyNames;
+        std::string pool;
+
+        auto intern = [&pool](const std::string& text) {
+            StrRef ref{static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(text.size())};
+            pool += text;
+            return ref;
+        };
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(source, line)) {
+            ++lineNumber;
+            auto fields = splitFields(line);
+            if (fields.empty() || fields[0].empty() || fields[0][0] == '#') {
+                continue;
+            }
+            const std::string& kind = fields[0];
+            auto fail = [lineNumber](const std::string& message) {
+                throw std::runtime_error("World source line " + std::to_string(lineNumber) + ": " + message);
+            };
+
+            if (kind == "location" && fields.size() == 3) {
+                locationNames.emplace(fields[1], static_cast<uint32_t>(locations.size()));
+                locations.push_back({intern(fields[1]), intern(fields[2]),
+                                     static_cast<uint32_t>(interactions.size()), 0});
+            } else if (kind == "interaction" && fields.size() == 3) {
+                if (locations.empty()) {
+                    fail("interaction before any location");
+                }
+                interactions.push_back({intern(fields[1]), intern(fields[2])});
+                locations.back().interactionCount++;
+            } else if (kind == "item" && fields.size() >= 3 && fields.size() <= 5) {
+                if (locations.empty()) {
+                    fail("item before any location");
+                }
+                bool usable = fields.size() >= 4 && fields[3] == "usable";
+                items.push_back({intern(fields[1]), intern(fields[2]),
+                                 static_cast<uint32_t>(locations.size() - 1), usable ? 1u : 0u,
+                                 intern(fields.size() == 5 ? fields[4] : "")});
+            } else if (kind == "enemy" && fields.size() == 6) {
+                enemyNames.emplace(fields[1], static_cast<uint32_t>(enemies.size()));
+                try {
+                    enemies.push_back({intern(fields[1]), intern(fields[2]), std::stoi(fields[3]),
+                                       std::stoi(fields[4]), std::stoi(fields[5])});
+                } catch (const std::logic_error&) {
+                    fail("enemy stats must be numbers");
+                }
+            } else if (kind == "exit" && fields.size() == 2) {
+                if (locations.empty()) {
+                    fail("exit before any location");
+                }
+                exits.push_back({static_cast<uint32_t>(locations.size() - 1), 0});
+                exitTargets.emplace_back(fields[1], lineNumber);
+            } else if (kind == "patrol" && fields.size() >= 4) {
+                if (fields[2].empty() || fields[2].find_first_not_of("0123456789") != std::string::npos ||
+                    fields[2].size() > 6 || std::stoul(fields[2]) == 0) {
+                    fail("patrol ticks per room must be a positive number");
+                }
+                patrols.push_back({0, static_cast<uint32_t>(std::stoul(fields[2])), 0, 0});
+                std::vector<std::string> names{fields[1]};
+                names.insert(names.end(), fields.begin() + 3, fields.end());
+                patrolNames.emplace_back(std::move(names), lineNumber);
+            } else if (kind == "on" && fields.size() >= 2) {
+                auto event = std::find(std::begin(EVENT_NAMES), std::end(EVENT_NAMES), fields[1]);
+                if (event == std::end(EVENT_NAMES) || (fields.size() == 3) == (fields[1] == "turn") ||
+                    fields.size() > 3) {
+                    fail("expected 'on | use | <item>', 'on | interact | <key>', 'on | turn' or 'on | timer | <tick>'");
+                }
+                if (fields[1] == "timer" && (fields[2].empty() || fields[2].find_first_not_of("0123456789") != std::string::npos)) {
+                    fail("timer tick must be a number");
+                }
+                triggers.push_back({static_cast<uint32_t>(event - std::begin(EVENT_NAMES)),
+                                    intern(fields.size() == 3 ? fields[2] : ""), 0, 0, 0});
+                conditions.emplace_back();
+                actions.emplace_back();
+            } else if (kind == "if" && fields.size() == 3) {
+                if (triggers.empty()) {
+                    fail("condition before any trigger");
+                }
+                bool negate = fields[1].compare(0, 4, "not ") == 0;
+                std::string name = negate ? fields[1].substr(4) : fields[1];
+                auto op = std::find(OP_NAMES, OP_NAMES + static_cast<size_t>(TriggerOp::SAY), name);
+                if (op == OP_NAMES + static_cast<size_t>(TriggerOp::SAY)) {
+                    fail("unknown condition '" + fields[1] + "'");
+                }
+                conditions.back().push_back({static_cast<uint32_t>(op - OP_NAMES), negate ? 1u : 0u,
+                                             intern(fields[2])});
+            } else if (kind == "do" && (fields.size() == 2 || fields.size() == 3)) {
+                if (triggers.empty()) {
+                    fail("action before any trigger");
+                }
+                auto op = std::find(OP_NAMES + static_cast<size_t>(TriggerOp::SAY), OP_NAMES + TRIGGER_OPS, fields[1]);
+                if (op == OP_NAMES + TRIGGER_OPS || (fields.size() == 2) != (fields[1] == "escape")) {
+                    fail("unknown action '" + fields[1] + "'");
+                }
+                std::string arg = fields.size() == 3 ? fields[2] : "";
+                if (fields[1] == "xp" && (arg.empty() || arg.find_first_not_of("0123456789") != std::string::npos)) {
+                    fail("experience must be a number");
+                }
+                actions.back().push_back({static_cast<uint32_t>(op - OP_NAMES), 0, intern(unescape(arg))});
+            } else {
+                fail("unrecognised line '" + line + "'");
+            }
+        }
+        if (locations.empty()) {
+            throw std::runtime_error("World source defines no locations");
+        }
+        for (size_t i = 0; i < exits.size(); ++i) {
+            auto it = locationNames.find(exitTargets[i].first);
+            if (it == locationNames.end()) {
+                throw std::runtime_error("World source line " + std::to_string(exitTargets[i].second) +
+                                         ": exit to unknown location '" + exitTargets[i].first + "'");
+            }
+            exits[i].to = it->second;
+        }
+        std::vector<uint32_t> waypoints;
+        for (size_t i = 0; i < patrols.size(); ++i) {
+            const auto& [names, patrolLine] = patrolNames[i];
+            auto unknown = [patrolLine = patrolLine](const char* what, const std::string& name) {
+                return std::runtime_error("World source line " + std::to_string(patrolLine) + ": patrol of unknown " +
+                                          what + " '" + name + "'");
+            };
+            auto enemy = enemyNames.find(names[0]);
+            if (enemy == enemyNames.end()) {
+                throw unknown("enemy", names[0]);
+            }
+            patrols[i].enemy = enemy->second;
+            patrols[i].firstWaypoint = static_cast<uint32_t>(waypoints.size());
+            patrols[i].waypointCount = static_cast<uint32_t>(names.size() - 1);
+            for (size_t j = 1; j < names.size(); ++j) {
+                auto location = locationNames.find(names[j]);
+                if (location == locationNames.end()) {
+                    throw unknown("location", names[j]);
+                }
+                waypoints.push_back(location->second);
+            }
+        }
+        std::vector<StepRecord> steps;
+        for (size_t i = 0; i < triggers.size(); ++i) {
+            triggers[i].firstStep = static_cast<uint32_t>(steps.size());
+            triggers[i].conditionCount = static_cast<uint32_t>(conditions[i].size());
+            triggers[i].actionCount = static_cast<uint32_t>(actions[i].size());
+            steps.insert(steps.end(), conditions[i].begin(), conditions[i].end());
+            steps.insert(steps.end(), actions[i].begin(), actions[i].end());
+        }
+
+        WorldHeader header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.locationCount = static_cast<uint32_t>(locations.size());
+        header.interactionCount = static_cast<uint32_t>(interactions.size());
+        header.itemCount = static_cast<uint32_t>(items.size());
+        header.enemyCount = static_cast<uint32_t>(enemies.size());
+        header.exitCount = static_cast<uint32_t>(exits.size());
+        header.patrolCount = static_cast<uint32_t>(patrols.size());
+        header.waypointCount = static_cast<uint32_t>(waypoints.size());
+        header.triggerCount = static_cast<uint32_t>(triggers.size());
+        header.stepCount = static_cast<uint32_t>(steps.size());
+        header.stringBytes = static_cast<uint32_t>(pool.size());
+
+        std::string image;
+        append(image, header);
+        for (const auto& record : locations) append(image, record);
+        for (const auto& record : interactions) append(image, record);
+        for (const auto& record : items) append(image, record);
+        for (const auto& record : enemies) append(image, record);
+        for (const auto& record : exits) append(image, record);
+        for (const auto& record : patrols) append(image, record);
+        for (uint32_t waypoint : waypoints) append(image, waypoint);
+        for (const auto& record : triggers) append(image, record);
+        for (const auto& record : steps) append(image, record);
+        image += pool;
+        return image;
+    }
+}
+
+// Read-only memory mapping of a whole (non-empty) file
+class MappedFile {
+private:
+    void* data;
+    size_t size;
+
+public:
+    explicit MappedFile(const std::string& path) : data(nullptr), size(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            size = static_cast<size_t>(info.st_size);
+            data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data == nullptr || data == MAP_FAILED) {
+            throw std::runtime_error("Cannot map " + path);
+        }
+    }
+
+    ~MappedFile() { ::munmap(data, size); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* bytes() const { return static_cast<const char*>(data); }
+    size_t length() const { return size; }
+};
+
+// Builds the definitions as views into a compiled world image; only the
+// small record tables are copied, none of the text.
+inline std::shared_ptr<const WorldData> WorldData::fromImage(std::shared_ptr<const void> owner,
+                                                             const char* data, size_t size) {
+    using namespace WorldFormat;
+    size_t offset = 0;
+    auto header = read<WorldHeader>(data, size, offset);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        throw std::runtime_error("Not a compiled world file (or wrong version)");
+    }
+    size_t poolOffset = size - std::min<size_t>(size, header.stringBytes);
+    const char* pool = data + poolOffset;
+    auto view = [&](const StrRef& ref) {
+        if (size_t(ref.offset) + ref.length > header.stringBytes) {
+            throw std::runtime_error("World file string out of range");
+        }
+        return std::string_view(pool + ref.offset, ref.length);
+    };
+
+    auto world = std::make_shared<WorldData>();
+    std::vector<LocationRecord> locationRecords;
+    for (uint32_t i = 0; i < header.locationCount; ++i) {
+        locationRecords.push_back(read<LocationRecord>(data, poolOffset, offset));
+    }
+    std::vector<InteractionRecord> interactionRecords;
+    for (uint32_t i = 0; i < header.interactionCount; ++i) {
+        interactionRecords.push_back(read<InteractionRecord>(data, poolOffset, offset));
+    }
+    for (const auto& record : locationRecords) {
+        LocationDef def{view(record.name), view(record.description), {}};
+        if (size_t(record.firstInteraction) + record.interactionCount > interactionRecords.size()) {
+            throw std::runtime_error("World file interaction out of range");
+        }
+        for (uint32_t i = 0; i < record.interactionCount; ++i) {
+            const auto& interaction = interactionRecords[record.firstInteraction + i];
+            def.interactions.emplace_back(view(interaction.key), view(interaction.response));
+        }
+        world->locations.push_back(std::move(def));
+    }
+    for (uint32_t i = 0; i < header.itemCount; ++i) {
+        auto record = read<ItemRecord>(data, poolOffset, offset);
+        if (record.location >= world->locations.size()) {
+            throw std::runtime_error("World file item location out of range");
+        }
+        world->items.push_back({view(record.name), view(record.description), record.location, record.usable != 0,
+                                view(record.usage)});
+    }
+    for (uint32_t i = 0; i < header.enemyCount; ++i) {
+        auto record = read<EnemyRecord>(data, poolOffset, offset);
+        world->enemies.push_back({view(record.name), view(record.type), record.health, record.attack, record.defense});
+    }
+    for (uint32_t i = 0; i < header.exitCount; ++i) {
+        auto record = read<ExitRecord>(data, poolOffset, offset);
+        if (record.from >= world->locations.size() || record.to >= world->locations.size()) {
+            throw std::runtime_error("World file exit out of range");
+        }
+        world->exits.emplace_back(record.from, record.to);
+    }
+    std::vector<PatrolRecord> patrolRecords;
+    for (uint32_t i = 0; i < header.patrolCount; ++i) {
+        patrolRecords.push_back(read<PatrolRecord>(data, poolOffset, offset));
+    }
+    std::vector<uint32_t> waypoints;
+    for (uint32_t i = 0; i < header.waypointCount; ++i) {
+        waypoints.push_back(read<uint32_t>(data, poolOffset, offset));
+    }
+    for (const auto& record : patrolRecords) {
+        if (size_t(record.firstWaypoint) + record.waypointCount > waypoints.size()) {
+            throw std::runtime_error("World file patrol out of range");
+        }
+        world->patrols.push_back({record.enemy, record.ticksPerRoom,
+                                  {waypoints.begin() + record.firstWaypoint,
+                                   waypoints.begin() + record.firstWaypoint + record.waypointCount}});
+    }
+    std::vector<TriggerRecord> triggerRecords;
+    for (uint32_t i = 0; i < header.triggerCount; ++i) {
+        triggerRecords.push_back(read<TriggerRecord>(data, poolOffset, offset));
+    }
+    std::vector<TriggerDef::Step> steps;
+    for (uint32_t i = 0; i < header.stepCount; ++i) {
+        auto record = read<StepRecord>(data, poolOffset, offset);
+        if (record.op >= TRIGGER_OPS) {
+            throw std::runtime_error("World file trigger step out of range");
+        }
+        steps.push_back({static_cast<TriggerOp>(record.op), record.negate != 0, view(record.arg)});
+    }
+    for (const auto& record : triggerRecords) {
+        size_t conditionEnd = size_t(record.firstStep) + record.conditionCount;
+        if (record.event >= TRIGGER_EVENTS || conditionEnd + record.actionCount > steps.size()) {
+            throw std::runtime_error("World file trigger out of range");
+        }
+        TriggerDef def{static_cast<TriggerEvent>(record.event), view(record.subject),
+                       {steps.begin() + record.firstStep, steps.begin() + conditionEnd},
+                       {steps.begin() + conditionEnd, steps.begin() + conditionEnd + record.actionCount}};
+        for (const auto& step : def.conditions) {
+            if (!isCondition(step.op)) {
+                throw std::runtime_error("World file trigger condition is an action");
+            }
+        }
+        for (const auto& step : def.actions) {
+            if (isCondition(step.op)) {
+                throw std::runtime_error("World file trigger action is a condition");
+            }
+        }
+        world->triggers.push_back(std::move(def));
+    }
+    if (world->locations.empty()) {
+        throw std::runtime_error("World file defines no locations");
+    }
+    world->finalize();
+    world->storage = std::move(owner);
+    return world;
+}
+
+// Maps a compiled world file, or compiles a text world source in memory
+inline std::shared_ptr<const WorldData> WorldData::load(const std::string& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (file->length() >= sizeof(WorldFormat::MAGIC) &&
+        std::memcmp(file->bytes(), WorldFormat::MAGIC, sizeof(WorldFormat::MAGIC)) == 0) {
+        return fromImage(file, file->bytes(), file->length());
+    }
+    std::istringstream source(std::string(file->bytes(), file->length()));
+    auto image = std::make_shared<std::string>(WorldFormat::compile(source));
+    return fromImage(image, image->data(), image->size());
+}
+
+// Compiled text tables: a header, a record per message naming it by key,
+// then the string pool. Keys are looked up once, when the table loads, so
+// a table compiled before messages were added still loads; the messages it
+// lacks stay English.
+namespace TextFormat {
+    using WorldFormat::StrRef;
+
+    const char MAGIC[4] = {'S', 'D', 'T', 'X'};
+    const uint32_t VERSION = 1;
+
+    struct TextHeader {
+        char magic[4];
+        uint32_t version;
+        StrRef locale;
+        uint32_t messageCount;
+        uint32_t stringBytes;
+    };
+
+    struct MessageRecord { StrRef key; StrRef text; };
+
+    // Packs a text table source into the binary image. Source lines:
+    //   locale | <name>
+    //   <key>  | <text>
+    // The text is the rest of the line after "| ", trailing spaces
+    // included. "\n" in it breaks a line, and {0}..{9} are the message's
+    // arguments, which must be among those of the English text.
+    // Blank lines and lines starting with '#' are ignored.
+    inline std::string compile(std::istream& source) {
+        std::string locale;
+        std::vector<std::pair<std::string, std::string>> messages;
+        std::vector<bool> seen(Text::COUNT);
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(source, line)) {
+            ++lineNumber;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            size_t begin = line.find_first_not_of(" \t");
+            if (begin == std::string::npos || line[begin] == '#') {
+                continue;
+            }
+            auto fail = [lineNumber](const std::string& message) {
+                throw std::runtime_error("Text source line " + std::to_string(lineNumber) + ": " + message);
+            };
+            size_t bar = line.find('|');
+            if (bar == std::string::npos || bar == begin) {
+                fail("expected <key> | <text>");
+            }
+            std::string key = line.substr(begin, line.find_last_not_of(" \t", bar - 1) + 1 - begin);
+            size_t start = bar + 1 < line.size() && line[bar + 1] == ' ' ? bar + 2 : bar + 1;
+            std::string text = WorldFormat::unescape(line.substr(start));
+            if (key == "locale") {
+                locale = text;
+                continue;
+            }
+            auto id = Text::find(key);
+            if (!id) {
+                fail("unknown message " + key);
+            }
+            if (seen[*id]) {
+                fail("message " + key + " given twice");
+            }
+            seen[*id] = true;
+            if (Text::highestArgument(text) > Text::highestArgument(Text::MESSAGES[*id].english)) {
+                fail("message " + key + " refers to an argument it does not have");
+            }
+            messages.emplace_back(std::move(key), std::move(text));
+        }
+
+        std::string pool;
+        auto intern = [&pool](const std::string& text) {
+            StrRef ref{static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(text.size())};
+            pool += text;
+            return ref;
+        };
+        TextHeader header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.locale = intern(locale);
+        header.messageCount = static_cast<uint32_t>(messages.size());
+        std::vector<MessageRecord> records;
+        for (const auto& message : messages) {
+            records.push_back({intern(message.first), intern(message.second)});
+        }
+        header.stringBytes = static_cast<uint32_t>(pool.size());
+
+        std::string image;
+        WorldFormat::append(image, header);
+        for (const auto& record : records) WorldFormat::append(image, record);
+        image += pool;
+        return image;
+    }
+}
+
+inline std::shared_ptr<const TextTable> TextTable::fromImage(std::shared_ptr<const void> owner,
+                                                             const char* data, size_t size) {
+    using namespace TextFormat;
+    size_t offset = 0;
+    auto header = WorldFormat::read<TextHeader>(data, size, offset);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        throw std::runtime_error("Not a compiled text file (or wrong version)");
+    }
+    size_t poolOffset = size - std::min<size_t>(size, header.stringBytes);
+    const char* pool = data + poolOffset;
+    auto view = [&](const StrRef& ref) {
+        if (size_t(ref.offset) + ref.length > header.stringBytes) {
+            throw std::runtime_error("Text file string out of range");
+        }
+        return std::string_view(pool + ref.offset, ref.length);
+    };
+
+    auto table = std::make_shared<TextTable>();
+    table->owner = std::move(owner);
+    table->localeName = view(header.locale);
+    for (uint32_t i = 0; i < header.messageCount; ++i) {
+        auto record = WorldFormat::read<MessageRecord>(data, poolOffset, offset);
+        if (auto id = Text::find(view(record.key))) {
+            table->messages[*id] = view(record.text);
+        }
+    }
+    return table;
+}
+
+inline std::shared_ptr<const TextTable> TextTable::load(const std::string& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (file->length() >= sizeof(TextFormat::MAGIC) &&
+        std::memcmp(file->bytes(), TextFormat::MAGIC, sizeof(TextFormat::MAGIC)) == 0) {
+        return fromImage(file, file->bytes(), file->length());
+    }
+    std::istringstream source(std::string(file->bytes(), file->length()));
+    auto image = std::make_shared<std::string>(TextFormat::compile(source));
+    return fromImage(image, image->data(), image->size());
+}
+
+// The rooms of a station that many sessions play in at once. Each room is a
+// shard of its own, with its own lock, holding the items still lying in it
+// and the players standing in it. A session locks only the room it acts on,
+// and never two at once, so players in different rooms never wait for each
+// other, and an unchanged room is read without taking its lock at all.
+class SharedStation {
+public:
+    using Occupant = uint64_t;
+
+private:
+    // A cache line each, so the locks of neighbouring rooms do not contend
+    struct alignas(64) Room {
+        std::mutex mutex;
+        // World item indices
+        std::vector<uint32_t> items;
+        std::vector<std::pair<Occupant, std::string>> occupants;
+        // Bumped whenever items changes
+        std::atomic<uint64_t> version{0};
+    };
+
+    std::shared_ptr<const WorldData> world;
+    std::unique_ptr<Room[]> rooms;
+    std::atomic<Occupant> nextOccupant{0};
+
+public:
+    explicit SharedStation(std::shared_ptr<const WorldData> worldData)
+        : world(std::move(worldData)), rooms(new Room[world->locations.size()]) {
+        for (size_t i = 0; i < world->locations.size(); ++i) {
+            rooms[i].items = world->initialItemsOf(i);
+        }
+    }
+
+    const WorldData& worldData() const { return *world; }
+
+    Occupant join() { return nextOccupant.fetch_add(1, std::memory_order_relaxed); }
+
+    // Copies the items lying in a room into list unless they are still as
+    // they were at version `seen`. Returns whether it copied.
+    bool items(uint32_t room, uint64_t& seen, std::vector<uint32_t>& list) {
+        Room& shard = rooms[room];
+        if (shard.version.load(std::memory_order_acquire) == seen) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        list = shard.items;
+        seen = shard.version.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    // Takes an item out of a room if it is still there. However many
+    // players reach for it at once, exactly one of them gets it.
+    bool claim(uint32_t room, uint32_t item) {
+        Room& shard = rooms[room];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = std::find(shard.items.begin(), shard.items.end(), item);
+        if (it == shard.items.end()) {
+            return false;
+        }
+        shard.items.erase(it);
+        shard.version.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    void enter(uint32_t room, Occupant who, const std::string& name) {
+        Room& shard = rooms[room];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.occupants.emplace_back(who, name);
+    }
+
+    void leave(uint32_t room, Occupant who) {
+        Room& shard = rooms[room];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto& list = shard.occupants;
+        list.erase(std::remove_if(list.begin(), list.end(), [who](const auto& entry) { return entry.first == who; }),
+                   list.end());
+    }
+
+    // The names of everyone in a room but `who`, in order of arrival
+    std::vector<std::string> company(uint32_t room, Occupant who) {
+        Room& shard = rooms[room];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::vector<std::string> names;
+        for (const auto& [occupant, name] : shard.occupants) {
+            if (occupant != who) {
+                names.push_back(name);
+            }
+        }
+        return names;
+    }
+};
+
+// A session's locations, built from the shared world only when first needed.
+// At most `capacity` rooms stay built; when another is needed the least
+// recently used one is evicted to its serialized form, the world indices of
+// the items lying in it, which is all of a room's state that play changes.
+// Rooms never touched take no memory, and items are created the first time
+// a room or a save refers to them, so a session's footprint follows what it
+// touched rather than the size of the world.
+// In a shared station the items of a room are the station's: a room shows
+// what the station holds whenever it is looked at, and taking an item is a
+// claim on the station's room.
+class LocationStore {
+public:
+    using ItemFactory = std::function<Item*(uint32_t)>;
+
+private:
+    struct Room {
+        std::unique_ptr<Location> resident;
+        // The room's items while it is paged out
+        std::vector<uint32_t> items;
+        std::list<uint32_t>::iterator recent;
+        // Version of the shared room the items were copied at
+        uint64_t seen = ~uint64_t(0);
+    };
+
+    std::shared_ptr<const WorldData> world;
+    ItemFactory makeItem;
+    size_t capacity;
+    SharedStation* station;
+    std::unordered_map<uint32_t, Room> rooms;
+    // Resident rooms, most recently used first
+    std::list<uint32_t> recent;
+    std::unordered_map<uint32_t, Item*> items;
+    std::unordered_map<const Item*, uint32_t> indices;
+    size_t loads;
+
+    std::vector<uint32_t> serialize(const Location& location) const {
+        std::vector<uint32_t> list;
+        for (const Item* entry : location.getItems()) {
+            list.push_back(indices.at(entry));
+        }
+        return list;
+    }
+
+    // A room seen for the first time holds the items the world puts there
+    Room& room(uint32_t index) {
+        auto [it, inserted] = rooms.try_emplace(index);
+        if (inserted) {
+            if (!station) {
+                it->second.items = world->initialItemsOf(index);
+            }
+            it->second.recent = recent.end();
+        }
+        return it->second;
+    }
+
+    // Brings a resident room up to date with the shared station
+    void refresh(uint32_t index, Room& entry) {
+        std::vector<uint32_t> list;
+        if (station->items(index, entry.seen, list)) {
+            entry.resident->clearItems();
+            for (uint32_t itemIndex : list) {
+                entry.resident->addItem(item(itemIndex));
+            }
+        }
+    }
+
+    void evictLeastRecent() {
+        Room& victim = rooms.at(recent.back());
+        victim.items = serialize(*victim.resident);
+        victim.resident.reset();
+        victim.recent = recent.end();
+        recent.pop_back();
+    }
+
+public:
+    LocationStore(std::shared_ptr<const WorldData> worldData, ItemFactory factory, size_t residentRooms,
+                  SharedStation* sharedStation = nullptr)
+        : world(std::move(worldData)), makeItem(std::move(factory)),
+          capacity(std::max<size_t>(residentRooms, 1)), station(sharedStation), loads(0) {}
+
+    size_t size() const { return world->locations.size(); }
+
+    // The location at index, paged in if needed. The reference stays valid
+    // until `capacity` other locations have been asked for.
+    Location& operator[](size_t index) {
+        if (index >= size()) {
+            throw std::out_of_range("No location " + std::to_string(index));
+        }
+        Room& entry = room(static_cast<uint32_t>(index));
+        if (entry.resident) {
+            recent.splice(recent.begin(), recent, entry.recent);
+            if (station) {
+                refresh(static_cast<uint32_t>(index), entry);
+            }
+            return *entry.resident;
+        }
+        if (recent.size() >= capacity) {
+            evictLeastRecent();
+        }
+        if (station) {
+            entry.seen = ~uint64_t(0);
+            station->items(static_cast<uint32_t>(index), entry.seen, entry.items);
+        }
+        auto location = std::make_unique<Location>(world->locations[index]);
+        for (uint32_t itemIndex : entry.items) {
+            location->addItem(item(itemIndex));
+        }
+        entry.items.clear();
+        entry.resident = std::move(location);
+        recent.push_front(static_cast<uint32_t>(index));
+        entry.recent = recent.begin();
+        loads++;
+        return *entry.resident;
+    }
+
+    // The item at index in the world's item list, created on first use
+    Item* item(uint32_t index) {
+        auto it = items.find(index);
+        if (it != items.end()) {
+            return it->second;
+        }
+        if (index >= world->items.size()) {
+            throw std::out_of_range("No item " + std::to_string(index));
+        }
+        Item* created = makeItem(index);
+        items.emplace(index, created);
+        indices.emplace(created, index);
+        return created;
+    }
+
+    uint32_t indexOf(const Item* entry) const { return indices.at(entry); }
+
+    // Takes an item out of a room for the player. In a shared station it
+    // goes to whoever claims it first; returns false if someone else did.
+    bool take(size_t index, ItemHandle handle, const Item* entry) {
+        if (!station) {
+            (*this)[index].removeItem(handle);
+            return true;
+        }
+        bool claimed = station->claim(static_cast<uint32_t>(index), indexOf(entry));
+        (*this)[index];
+        return claimed;
+    }
+
+    // Rooms that may differ from the world, i.e. all that were touched, in order
+    std::vector<uint32_t> touched() const {
+        std::vector<uint32_t> list;
+        for (const auto& entry : rooms) {
+            list.push_back(entry.first);
+        }
+        std::sort(list.begin(), list.end());
+        return list;
+    }
+
+    std::vector<uint32_t> itemsIn(uint32_t index) const {
+        const Room& entry = rooms.at(index);
+        return entry.resident ? serialize(*entry.resident) : entry.items;
+    }
+
+    // Replaces a room's items without paging it in
+    void setItems(uint32_t index, std::vector<uint32_t> list) {
+        Room& entry = room(index);
+        if (entry.resident) {
+            entry.resident->clearItems();
+            for (uint32_t itemIndex : list) {
+                entry.resident->addItem(item(itemIndex));
+            }
+        } else {
+            for (uint32_t itemIndex : list) {
+                item(itemIndex);
+            }
+            entry.items = std::move(list);
+        }
+    }
+
+    size_t residentCount() const { return recent.size(); }
+    size_t loadCount() const { return loads; }
+
+    // Whether the rooms built are consistent, and no item lies in two rooms
+    // at once or lies in one while it is carried. For invariant checks.
+    bool consistent(const Inventory& carried) const {
+        std::vector<bool> placed(world->items.size());
+        auto place = [this, &placed](const Item* entry) {
+            auto it = indices.find(entry);
+            if (it == indices.end() || placed[it->second]) {
+                return false;
+            }
+            placed[it->second] = true;
+            return true;
+        };
+        for (const Item* entry : carried) {
+            if (!place(entry)) {
+                return false;
+            }
+        }
+        for (const auto& [index, entry] : rooms) {
+            if (entry.resident) {
+                if (!entry.resident->getItems().consistent()) {
+                    return false;
+                }
+                for (const Item* lying : entry.resident->getItems()) {
+                    if (!place(lying)) {
+                        return false;
+                    }
+                }
+            } else {
+                for (uint32_t itemIndex : entry.items) {
+                    if (itemIndex >= placed.size() || placed[itemIndex]) {
+                        return false;
+                    }
+                    placed[itemIndex] = true;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// Save file layout: one full frame followed by any number of delta frames,
+// appended as the session is checkpointed. Each frame is
+//   FrameHeader
+//   SectionHeader + payload, sectionCount times
+// A full frame holds every section; a delta holds only the sections whose
+// bytes changed since the previous frame and replaces them on load. Items
+// are stored as indices into the world's item list and quest flags by
+// their interned IDs, which the order of Names fixes.
+namespace SaveFormat {
+    const char MAGIC[4] = {'S', 'D', 'S', 'V'};
+    const uint32_t VERSION = 1;
+
+    enum FrameKind : uint32_t { FULL = 0, DELTA = 1 };
+
+    // Payloads:
+    //   SESSION         SessionRecord, uint64_t combatSeeds[combatCount]
+    //   PLAYER          PlayerRecord, name bytes
+    //   INVENTORY       uint32_t item[]
+    //   ENEMIES         int32_t health[]
+    //   LOCATION_ITEMS  uint32_t item[]   (one section per location, by index)
+    //   CLOCK           ClockRecord, PatrolState patrols[]
+    //   VISITED         uint32_t location[]
+    enum SectionTag : uint16_t { SESSION = 1, PLAYER, INVENTORY, ENEMIES, LOCATION_ITEMS, CLOCK, VISITED };
+
+    struct FrameHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t kind;
+        uint32_t sequence;
+        uint32_t frameBytes;
+        uint32_t sectionCount;
+        // Shape of the world the save was made in
+        uint32_t locationCount;
+        uint32_t itemCount;
+        uint32_t enemyCount;
+    };
+
+    struct SectionHeader { uint16_t tag; uint16_t index; uint32_t bytes; };
+
+    struct SessionRecord { uint64_t seed; uint64_t rngState[4]; int32_t currentLocation; uint32_t combatCount; };
+    struct PlayerRecord {
+        int32_t health;
+        int32_t energy;
+        int32_t experience;
+        int32_t totalSteps;
+        int32_t itemsCollected;
+        uint32_t nameLength;
+        uint64_t flags[MAX_QUEST_FLAGS / 64];
+    };
+    struct ClockRecord { uint64_t tick; uint32_t nextTimer; uint32_t reserved; };
+    struct PatrolState { uint32_t room; uint32_t waypoint; uint32_t progress; };
+
+    // A section of a save file; the payload points into the file's bytes
+    struct Section {
+        uint16_t tag;
+        uint16_t index;
+        std::string_view payload;
+    };
+
+    template<typename T>
+    T read(std::string_view data, size_t& offset) {
+        if (offset + sizeof(T) > data.size()) {
+            throw std::runtime_error("Save file is truncated");
+        }
+        T record;
+        std::memcpy(&record, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return record;
+    }
+
+    // Reads a payload that is a plain array of T
+    template<typename T>
+    std::vector<T> readArray(std::string_view payload) {
+        std::vector<T> values(payload.size() / sizeof(T));
+        if (!values.empty()) {
+            std::memcpy(values.data(), payload.data(), values.size() * sizeof(T));
+        }
+        return values;
+    }
+
+    inline std::string section(uint16_t tag, uint16_t index, const std::string& payload) {
+        std::string bytes;
+        WorldFormat::append(bytes, SectionHeader{tag, index, static_cast<uint32_t>(payload.size())});
+        return bytes + payload;
+    }
+
+    // Applies every frame in order and returns the resulting sections.
+    // A frame cut short at the end of the file (a crash mid-append) is
+    // ignored, so the save falls back to the last complete checkpoint.
+    inline std::vector<Section> readSections(const char* data, size_t size, const WorldData& world) {
+        std::vector<Section> sections;
+        size_t offset = 0;
+        uint32_t sequence = 0;
+        while (size - offset >= sizeof(FrameHeader)) {
+            size_t start = offset;
+            auto header = read<FrameHeader>(std::string_view(data, size), offset);
+            if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+                throw std::runtime_error("Not a save file (or wrong version)");
+            }
+            if (header.locationCount != world.locations.size() || header.itemCount != world.items.size() ||
+                header.enemyCount != world.enemies.size()) {
+                throw std::runtime_error("Save file was made in a different world");
+            }
+            if ((start == 0) != (header.kind == FULL) || (start != 0 && header.sequence != sequence + 1)) {
+                throw std::runtime_error("Save file frames are out of order");
+            }
+            if (header.frameBytes < sizeof(FrameHeader) || header.frameBytes > size - start) {
+                break;
+            }
+            std::string_view frame(data + start, header.frameBytes);
+            size_t cursor = sizeof(FrameHeader);
+            for (uint32_t i = 0; i < header.sectionCount; ++i) {
+                auto sectionHeader = read<SectionHeader>(frame, cursor);
+                if (sectionHeader.bytes > frame.size() - cursor) {
+                    throw std::runtime_error("Save file section is truncated");
+                }
+                Section next{sectionHeader.tag, sectionHeader.index, frame.substr(cursor, sectionHeader.bytes)};
+                cursor += sectionHeader.bytes;
+                auto it = std::find_if(sections.begin(), sections.end(), [&next](const Section& existing) {
+                    return existing.tag == next.tag && existing.index == next.index;
+                });
+                if (it != sections.end()) {
+                    *it = next;
+                } else {
+                    sections.push_back(next);
+                }
+            }
+            offset = start + header.frameBytes;
+            sequence = header.sequence;
+        }
+        if (sections.empty()) {
+            throw std::runtime_error("Save file holds no complete snapshot");
+        }
+        return sections;
+    }
+
+    inline std::string playerName(const std::vector<Section>& sections) {
+        for (const auto& section : sections) {
+            if (section.tag == PLAYER) {
+                size_t offset = 0;
+                auto record = read<PlayerRecord>(section.payload, offset);
+                if (record.nameLength > section.payload.size() - offset) {
+                    throw std::runtime_error("Save file player name is truncated");
+                }
+                return std::string(section.payload.substr(offset, record.nameLength));
+            }
+        }
+        throw std::runtime_error("Save file has no player");
+    }
+}
+
+// Append-only journal of what every session read and drew, so any session
+// can be replayed exactly. Layout:
+//   "SDJL" uint32_t version
+//   RecordHeader + payload, repeated
+// Records of concurrent sessions interleave and carry their session ID.
+// Appends never block: a committer thread writes whatever has accumulated
+// as one batch with a single fdatasync (group commit), so the sessions
+// share their syncs and a crash loses at most the batch in flight.
+// A batch that cannot be written or synced is cut off again, so the file
+// stays a valid prefix, and the journal takes no more records: sync() and
+// check() throw from then on.
+class Journal {
+public:
+    enum Kind : uint32_t {
+        BEGIN = 1,     // BeginRecord
+        INPUT,         // one line of input, as read
+        COMBAT_SEED,   // uint64_t seed of a fight
+        END,           // the session finished normally
+        TICK           // uint64_t world ticks that passed between inputs
+    };
+
+    struct RecordHeader { uint32_t session; uint32_t kind; uint32_t length; };
+    struct BeginRecord { uint64_t seed; uint32_t headless; uint32_t shared; };
+
+    struct Record {
+        uint32_t session;
+        uint32_t kind;
+        std::string payload;
+    };
+
+    static constexpr char MAGIC[4] = {'S', 'D', 'J', 'L'};
+    static constexpr uint32_t VERSION = 1;
+
+private:
+    int fd;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable committed;
+    std::string pending;
+    uint64_t appended;
+    uint64_t durable;
+    uint32_t nextSession;
+    size_t commits;
+    bool stopping;
+    // errno of the write or sync that failed; 0 while all is well
+    int error;
+    // Length of the file up to the end of the last durable batch. Only the
+    // committer touches it once the constructor has returned.
+    uint64_t fileBytes;
+    std::thread committer;
+
+    // Writes and syncs one batch, returning 0 or the errno that stopped it.
+    // A failed batch is truncated away, torn record and all.
+    int commitBatch(const std::string& batch) {
+        int failure = 0;
+        size_t written = 0;
+        while (written < batch.size()) {
+            ssize_t n = ::write(fd, batch.data() + written, batch.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                failure = n < 0 ? errno : EIO;
+                break;
+            }
+            written += static_cast<size_t>(n);
+        }
+        if (failure == 0 && ::fdatasync(fd) != 0) {
+            failure = errno;
+        }
+        if (failure == 0) {
+            fileBytes += batch.size();
+        } else if (::ftruncate(fd, static_cast<off_t>(fileBytes)) != 0) {
+            // The tear stays, but nothing is appended after it, so read()
+            // still stops there
+        }
+        return failure;
+    }
+
+    void commitLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            // Everything queued so far goes out in one write and one sync;
+            // sessions keep appending to the next batch meanwhile
+            std::string batch;
+            batch.swap(pending);
+            uint64_t batchEnd = appended;
+            if (error != 0) {
+                continue;
+            }
+            lock.unlock();
+            int failure = commitBatch(batch);
+            lock.lock();
+            if (failure == 0) {
+                durable = batchEnd;
+                commits++;
+            } else {
+                error = failure;
+            }
+            committed.notify_all();
+        }
+    }
+
+    // Whether the file holds less than a header, and what it holds is the
+    // start of one
+    static bool tornHeader(const std::string& path, const struct stat& info) {
+        char header[sizeof(MAGIC) + sizeof(VERSION)];
+        std::memcpy(header, MAGIC, sizeof(MAGIC));
+        std::memcpy(header + sizeof(MAGIC), &VERSION, sizeof(VERSION));
+        if (static_cast<size_t>(info.st_size) >= sizeof(header)) {
+            return false;
+        }
+        std::ifstream file(path, std::ios::binary);
+        char start[sizeof(header)];
+        file.read(start, info.st_size);
+        return file && std::memcmp(start, header, static_cast<size_t>(info.st_size)) == 0;
+    }
+
+public:
+    // Reads every complete record; a record cut short by a crash ends the
+    // list. validBytes receives the length of the intact prefix.
+    static std::vector<Record> read(const std::string& path, size_t* validBytes = nullptr) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Cannot open journal " + path);
+        }
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        uint32_t version = 0;
+        if (data.size() < sizeof(MAGIC) + sizeof(version) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("Not a journal: " + path);
+        }
+        std::memcpy(&version, data.data() + sizeof(MAGIC), sizeof(version));
+        if (version != VERSION) {
+            throw std::runtime_error("Unsupported journal version in " + path);
+        }
+
+        std::vector<Record> records;
+        size_t offset = sizeof(MAGIC) + sizeof(version);
+        while (data.size() - offset >= sizeof(RecordHeader)) {
+            RecordHeader header;
+            std::memcpy(&header, data.data() + offset, sizeof(header));
+            if (header.length > data.size() - offset - sizeof(header)) {
+                break;
+            }
+            records.push_back({header.session, header.kind, data.substr(offset + sizeof(header), header.length)});
+            offset += sizeof(header) + header.length;
+        }
+        if (validBytes) {
+            *validBytes = offset;
+        }
+        return records;
+    }
+
+    // Opens or creates the journal at path. A torn record left at the end
+    // by a crash is cut off, and new sessions are numbered after the
+    // ones already in the file. A crash while the header was being written
+    // leaves only part of it, and such a file is started afresh.
+    explicit Journal(const std::string& path)
+        : fd(-1), appended(0), durable(0), nextSession(0), commits(0), stopping(false), error(0),
+          fileBytes(0) {
+        struct stat info;
+        bool existing = ::stat(path.c_str(), &info) == 0 && info.st_size > 0;
+        if (existing && tornHeader(path, info)) {
+            if (::truncate(path.c_str(), 0) != 0) {
+                throw std::runtime_error("Cannot repair journal " + path);
+            }
+            existing = false;
+        }
+        if (existing) {
+            size_t validBytes = 0;
+            for (const auto& record : read(path, &validBytes)) {
+                nextSession = std::max(nextSession, record.session + 1);
+            }
+            if (::truncate(path.c_str(), static_cast<off_t>(validBytes)) != 0) {
+                throw std::runtime_error("Cannot repair journal " + path);
+            }
+            fileBytes = validBytes;
+        } else {
+            pending.append(MAGIC, sizeof(MAGIC));
+            pending.append(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+        }
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open journal " + path);
+        }
+        committer = std::thread(&Journal::commitLoop, this);
+    }
+
+    ~Journal() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_one();
+        committer.join();
+        ::close(fd);
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    uint32_t openSession() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return nextSession++;
+    }
+
+    void append(uint32_t session, Kind kind, std::string_view payload) {
+        RecordHeader header{session, kind, static_cast<uint32_t>(payload.size())};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error != 0) {
+                return;
+            }
+            pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+            pending.append(payload.data(), payload.size());
+            appended += sizeof(header) + payload.size();
+        }
+        wakeup.notify_one();
+    }
+
+    // Blocks until everything appended so far is on disk. Throws if the
+    // journal failed before getting there.
+    void sync() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t target = appended;
+        wakeup.notify_one();
+        committed.wait(lock, [this, target] { return durable >= target || error != 0; });
+        throwIfFailed();
+    }
+
+    // Throws if a write or sync has failed, without waiting for anything
+    void check() {
+        std::lock_guard<std::mutex> lock(mutex);
+        throwIfFailed();
+    }
+
+    size_t commitCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return commits;
+    }
+
+private:
+    void throwIfFailed() const {
+        if (error != 0) {
+            throw std::runtime_error(std::string("Journal write failed: ") + std::strerror(error));
+        }
+    }
+};
+
+// One session's view of the journal. As an input stream buffer it hands the
+// game its input a line at a time from the source, journaling each line
+// before the game sees it.
+class SessionJournal : public std::streambuf {
+private:
+    Journal& journal;
+    uint32_t session;
+    std::streambuf* source;
+    std::string line;
+
+protected:
+    int_type underflow() override {
+        line.clear();
+        int_type ch;
+        while ((ch = source->sbumpc()) != traits_type::eof()) {
+            line.push_back(traits_type::to_char_type(ch));
+            if (ch == '\n') {
+                break;
+            }
+        }
+        if (line.empty()) {
+            return traits_type::eof();
+        }
+        input(line);
+        setg(&line[0], &line[0], &line[0] + line.size());
+        return traits_type::to_int_type(line[0]);
+    }
+
+public:
+    SessionJournal(Journal& j, std::streambuf* input)
+        : journal(j), session(j.openSession()), source(input) {}
+
+    uint32_t id() const { return session; }
+
+    // Journals input that reaches the game some other way
+    void input(std::string_view text) {
+        journal.append(session, Journal::INPUT, text);
+    }
+
+    void begin(uint64_t seed, bool headless, bool shared) {
+        Journal::BeginRecord record{seed, headless ? 1u : 0u, shared ? 1u : 0u};
+        journal.append(session, Journal::BEGIN,
+                       std::string_view(reinterpret_cast<const char*>(&record), sizeof(record)));
+    }
+
+    void combatSeed(uint64_t seed) {
+        journal.append(session, Journal::COMBAT_SEED,
+                       std::string_view(reinterpret_cast<const char*>(&seed), sizeof(seed)));
+    }
+
+    void tick(uint64_t count) {
+        journal.append(session, Journal::TICK,
+                       std::string_view(reinterpret_cast<const char*>(&count), sizeof(count)));
+    }
+
+    // Throws if the journal has failed, so that the session counts as failed
+    void end() {
+        journal.append(session, Journal::END, {});
+        journal.check();
+    }
+};
+
+// Lightweight always-compiled instrumentation. Each thread records into its
+// own store of log-linear latency histograms and counters, written only by
+// that thread with relaxed atomics, so recording takes no locks and shares
+// no cache lines. An exporter reads every store and aggregates. Nothing is
+// recorded until telemetry is enabled.
+namespace Telemetry {
+    enum Metric : size_t {
+        TURN_MOVE, TURN_INTERACT, TURN_PICKUP, TURN_INVENTORY, TURN_STATUS, TURN_QUIT, TURN_INVALID,
+        COMBAT, PICKUP, RENDER, TICK, METRIC_COUNT
+    };
+
+    enum Counter : size_t {
+        SESSIONS, STEPS, ITEMS_COLLECTED, COMBATS_WON, COMBATS_LOST, ESCAPES, COUNTER_COUNT
+    };
+
+    const char* const METRIC_NAMES[METRIC_COUNT] = {
+        "turn.move", "turn.interact", "turn.pickup", "turn.inventory", "turn.status", "turn.quit",
+        "turn.invalid", "combat", "pickup", "render", "tick"
+    };
 
-    void removeItem(const std::string& itemName) {
-        auto it = std::find_if(items.begin(), items.end(), [&](const std::shared_ptr<Item>& item) {
-            return item->getName() == itemName;
-        });
-        if (it != items.end()) {
-            items.erase(it);
+    const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+        "sessions", "steps", "items_collected", "combats_won", "combats_lost", "escapes"
+    };
+
+    // HDR-style buckets over nanoseconds: values below 2^SUB_BITS get a
+    // bucket each, above that every power of two is split into 2^SUB_BITS
+    // linear sub-buckets, so any value is within ~3% of its bucket
+    constexpr int SUB_BITS = 5;
+    constexpr int MAX_BITS = 36;  // ~68 s; longer values land in the last bucket
+    constexpr size_t BUCKETS = size_t(MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+    inline size_t bucketOf(uint64_t value) {
+        if (value < (uint64_t(1) << SUB_BITS)) {
+            return static_cast<size_t>(value);
         }
-        itemMap.erase(itemName);
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent >= MAX_BITS) {
+            return BUCKETS - 1;
+        }
+        size_t sub = static_cast<size_t>(value >> (exponent - SUB_BITS)) & ((size_t(1) << SUB_BITS) - 1);
+        return (size_t(exponent - SUB_BITS + 1) << SUB_BITS) + sub;
     }
 
-    std::string getName() const { return name; }
-    std::string getDescription() const { return description; }
-    
-    std::string interact(const std::string& key, Player* player) const {
+    // Smallest value that falls into the bucket
+    inline uint64_t bucketFloor(size_t bucket) {
+        size_t group = bucket >> SUB_BITS;
+        uint64_t sub = bucket & ((size_t(1) << SUB_BITS) - 1);
+        return group == 0 ? sub : (uint64_t(1) << SUB_BITS | sub) << (group - 1);
+    }
+
+    struct Histogram {
+        std::atomic<uint64_t> counts[BUCKETS];
+        std::atomic<uint64_t> max;
+    };
+
+    struct ThreadStore {
+        Histogram histograms[METRIC_COUNT];
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+    };
+
+    // Only the owning thread writes, so a relaxed load and store is enough
+    inline void bump(std::atomic<uint64_t>& cell, uint64_t amount = 1) {
+        cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    inline std::atomic<bool>& enabledFlag() {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    inline bool enabled() { return enabledFlag().load(std::memory_order_relaxed); }
+    inline void enable() { enabledFlag().store(true, std::memory_order_relaxed); }
+
+    // Stores outlive their threads so nothing recorded is lost
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadStore>> stores;
+    };
+
+    inline Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
 
-        auto it = interactions.find(key);
-        if (it != interactions.end()) {
-            if (key == "hack terminal" && !player->hasItem("Keycard")) {
-                return "The terminal is locked. You need a keycard to access it.";
+    inline ThreadStore& local() {
+        thread_local ThreadStore* store = [] {
+            auto created = std::make_unique<ThreadStore>();
+            for (auto& histogram : created->histograms) {
+                for (auto& count : histogram.counts) count.store(0, std::memory_order_relaxed);
+                histogram.max.store(0, std::memory_order_relaxed);
             }
-            return it->second;
+            for (auto& counter : created->counters) counter.store(0, std::memory_order_relaxed);
+            auto& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.stores.push_back(std::move(created));
+            return reg.stores.back().get();
+        }();
+        return *store;
+    }
+
+    inline void record(Metric metric, uint64_t nanoseconds) {
+        auto& histogram = local().histograms[metric];
+        bump(histogram.counts[bucketOf(nanoseconds)]);
+        if (nanoseconds > histogram.max.load(std::memory_order_relaxed)) {
+            histogram.max.store(nanoseconds, std::memory_order_relaxed);
         }
-        return "Nothing interesting happens.";
     }
-    
 
-    std::vector<std::shared_ptr<Item>> getItems() const {
-        return items;
+    inline void count(Counter counter, uint64_t amount = 1) {
+        if (enabled()) {
+            bump(local().counters[counter], amount);
+        }
+    }
+
+    // Sum over every thread's store at one moment
+    struct Summary {
+        std::vector<std::vector<uint64_t>> counts;
+        std::vector<uint64_t> max;
+        std::vector<uint64_t> counters;
+        size_t threads = 0;
+
+        uint64_t total(size_t metric) const {
+            return std::accumulate(counts[metric].begin(), counts[metric].end(), uint64_t(0));
+        }
+
+        uint64_t percentile(size_t metric, double fraction) const {
+            uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total(metric)));
+            uint64_t seen = 0;
+            for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+                seen += counts[metric][bucket];
+                if (seen >= rank && seen > 0) {
+                    return std::min(bucketFloor(bucket), max[metric]);
+                }
+            }
+            return 0;
+        }
+    };
+
+    inline Summary collect() {
+        Summary summary;
+        summary.counts.assign(METRIC_COUNT, std::vector<uint64_t>(BUCKETS, 0));
+        summary.max.assign(METRIC_COUNT, 0);
+        summary.counters.assign(COUNTER_COUNT, 0);
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const auto& store : reg.stores) {
+            for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+                const auto& histogram = store->histograms[metric];
+                for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+                    summary.counts[metric][bucket] += histogram.counts[bucket].load(std::memory_order_relaxed);
+                }
+                summary.max[metric] = std::max(summary.max[metric], histogram.max.load(std::memory_order_relaxed));
+            }
+            for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+                summary.counters[counter] += store->counters[counter].load(std::memory_order_relaxed);
+            }
+        }
+        summary.threads = reg.stores.size();
+        return summary;
+    }
+
+    inline void report(std::ostream& out, const Summary& summary) {
+        out << "# telemetry from " << summary.threads << " threads; latencies in microseconds,"
+            << " not counting time spent waiting for input\n";
+        out << std::left << std::setw(16) << "metric" << std::right << std::setw(10) << "count"
+            << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+            << std::setw(10) << "max" << '\n';
+        out << std::fixed << std::setprecision(1);
+        for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+            out << std::left << std::setw(16) << METRIC_NAMES[metric] << std::right
+                << std::setw(10) << summary.total(metric);
+            for (double fraction : {0.5, 0.9, 0.99}) {
+                out << std::setw(10) << summary.percentile(metric, fraction) / 1000.0;
+            }
+            out << std::setw(10) << summary.max[metric] / 1000.0 << '\n';
+        }
+        for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+            out << std::left << std::setw(16) << COUNTER_NAMES[counter] << std::right
+                << std::setw(10) << summary.counters[counter] << '\n';
+        }
+    }
+
+    // Enables telemetry and periodically rewrites a report file with the
+    // aggregate of every session so far; the last report is written on
+    // destruction
+    class Exporter {
+    private:
+        std::string path;
+        std::chrono::milliseconds interval;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool stopping;
+        std::thread worker;
+
+        void write() {
+            std::string temporary = path + ".tmp";
+            {
+                std::ofstream file(temporary, std::ios::trunc);
+                report(file, collect());
+            }
+            std::rename(temporary.c_str(), path.c_str());
+        }
+
+        void loop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wakeup.wait_for(lock, interval, [this] { return stopping; })) {
+                lock.unlock();
+                write();
+                lock.lock();
+            }
+        }
+
+    public:
+        Exporter(const std::string& file, std::chrono::milliseconds every)
+            : path(file), interval(every), stopping(false) {
+            enable();
+            worker = std::thread(&Exporter::loop, this);
+        }
+
+        ~Exporter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_one();
+            worker.join();
+            write();
+        }
+
+        Exporter(const Exporter&) = delete;
+        Exporter& operator=(const Exporter&) = delete;
+    };
+}
+
+struct GameOptions {
+    // Skip typewriter delays and "Press Enter" pauses
+    bool headless = false;
+    // Session RNG seed; drawn from std::random_device when not given
+    std::optional<uint64_t> seed;
+    // Resume from this save file if it exists, and checkpoint to it every turn
+    std::string savePath;
+    // Records the session's seeds; its input should be read through it too
+    SessionJournal* journal = nullptr;
+    // Locations kept built at once; others are paged out until entered again
+    size_t residentLocations = 16;
+    // Plays in this station, of the same world, together with every other
+    // session given it: its rooms and their items are shared, the rest of
+    // the session is its own
+    SharedStation* station = nullptr;
+    // Wording of the game's own messages; the built-in English when null
+    std::shared_ptr<const TextTable> text;
+};
+
+// Output buffer for one screen. Everything a turn prints is composed in a
+// preallocated buffer and goes to the terminal in a single write() when the
+// stream is flushed, which the game does once per frame, right before it
+// waits for input. Rendering code therefore ends lines with '\n', never
+// std::endl.
+class FrameBuffer : public std::streambuf {
+private:
+    int fd;
+    std::vector<char> frame;
+
+protected:
+    int_type overflow(int_type ch) override {
+        size_t used = pptr() - pbase();
+        frame.resize(frame.size() * 2);
+        setp(frame.data(), frame.data() + frame.size());
+        pbump(static_cast<int>(used));
+        if (ch != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        return present() ? 0 : -1;
+    }
+
+public:
+    explicit FrameBuffer(int outputFd = STDOUT_FILENO, size_t capacity = 16 * 1024)
+        : fd(outputFd), frame(std::max<size_t>(capacity, 64)) {
+        setp(frame.data(), frame.data() + frame.size());
+    }
+
+    ~FrameBuffer() override {
+        present();
+    }
+
+    // Writes the composed frame out and starts a new one
+    bool present() {
+        const char* data = pbase();
+        size_t remaining = pptr() - pbase();
+        while (remaining > 0) {
+            ssize_t written = ::write(fd, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                setp(frame.data(), frame.data() + frame.size());
+                return false;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        setp(frame.data(), frame.data() + frame.size());
+        return true;
+    }
+
+    size_t pending() const { return pptr() - pbase(); }
+};
+
+// Virtual screen between the game and the terminal. The game still clears
+// and reprints the whole screen every turn; this buffer catches
+// AnsiArt::CLEAR_SCREEN, composes the new screen off-line and, when the
+// frame is flushed, rewrites only the rows that differ from what the
+// terminal already shows, using cursor-positioning escapes. Rows at or
+// below the point where the player typed input are treated as unknown,
+// since the terminal echoed keystrokes onto them.
+class ScreenDiffBuffer : public std::streambuf {
+private:
+    struct Row {
+        std::string style;   // colour escape active when the row starts
+        std::string text;
+        bool operator==(const Row& other) const { return style == other.style && text == other.text; }
+        bool operator!=(const Row& other) const { return !(*this == other); }
+    };
+
+    static constexpr std::string_view CLEAR = "\033[2J\033[H";
+
+    std::streambuf* target;
+    size_t height;
+    std::vector<Row> shown;     // what the terminal displays since the last clear
+    std::vector<Row> next;      // screen being composed after a clear
+    size_t validRows;           // leading rows of shown known to match the terminal
+    bool composing;
+    size_t clearMatched;        // how much of CLEAR the last bytes matched
+    std::string escape;         // escape sequence being read
+    std::string style;          // colour escape currently active
+
+    std::vector<Row>& rows() { return composing ? next : shown; }
+
+    void trackStyle(char c) {
+        if (escape.empty()) {
+            if (c == '\033') {
+                escape += c;
+            }
+            return;
+        }
+        escape += c;
+        if (std::isalpha(static_cast<unsigned char>(c))) {
+            if (c == 'm') {
+                style = (escape == "\033[0m" || escape == "\033[m") ? "" : escape;
+            }
+            escape.clear();
+        }
+    }
+
+    void emit(char c) {
+        auto& screen = rows();
+        if (screen.empty()) {
+            screen.push_back({style, ""});
+        }
+        if (c == '\n') {
+            trackStyle(c);
+            screen.push_back({style, ""});
+        } else {
+            screen.back().text += c;
+            trackStyle(c);
+        }
+        if (!composing) {
+            target->sputc(c);
+            if (shown.size() > height) {
+                validRows = 0;  // the terminal scrolled
+            }
+        }
+    }
+
+    void put(char c) {
+        if (c == CLEAR[clearMatched]) {
+            if (++clearMatched == CLEAR.size()) {
+                clearMatched = 0;
+                beginScreen();
+            }
+            return;
+        }
+        if (clearMatched > 0) {
+            size_t held = clearMatched;
+            clearMatched = 0;
+            for (size_t i = 0; i < held; ++i) {
+                emit(CLEAR[i]);
+            }
+            if (c == CLEAR[0]) {
+                clearMatched = 1;
+                return;
+            }
+        }
+        emit(c);
+    }
+
+    void beginScreen() {
+        if (composing) {
+            render();
+        }
+        composing = true;
+        next.clear();
+        next.push_back({style, ""});
+    }
+
+    void write(std::string_view text) {
+        target->sputn(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    void moveTo(size_t row) {
+        std::string move = "\033[" + std::to_string(row + 1) + ";1H";
+        write(move);
+    }
+
+    void drawRow(const Row& row) {
+        write("\033[0m");
+        write(row.style);
+        write(row.text);
+        write("\033[K");
+    }
+
+    // Sends the composed screen, as a diff against the terminal when possible
+    void render() {
+        composing = false;
+        if (validRows == 0 || next.size() > height) {
+            write(CLEAR);
+            for (size_t i = 0; i < next.size(); ++i) {
+                if (i > 0) {
+                    write("\n");
+                }
+                write(next[i].text);
+            }
+        } else {
+            size_t last = next.size() - 1;
+            for (size_t i = 0; i < last; ++i) {
+                if (i < validRows && i < shown.size() && shown[i] == next[i]) {
+                    continue;
+                }
+                moveTo(i);
+                drawRow(next[i]);
+            }
+            if (shown.size() > next.size()) {
+                moveTo(next.size());
+                write("\033[J");
+            }
+            // The last row is always drawn so the cursor ends up behind it
+            moveTo(last);
+            drawRow(next[last]);
+            write(style.empty() ? std::string_view("\033[0m") : std::string_view(style));
+        }
+        shown.swap(next);
+        next.clear();
+        validRows = shown.size() - 1;
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (ch != traits_type::eof()) {
+            put(traits_type::to_char_type(ch));
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        for (std::streamsize i = 0; i < n; ++i) {
+            put(s[i]);
+        }
+        return n;
+    }
+
+    // End of a frame: the player may type onto the current row next
+    int sync() override {
+        if (composing) {
+            render();
+        } else if (!shown.empty()) {
+            validRows = std::min(validRows, shown.size() - 1);
+        }
+        return target->pubsync();
+    }
+
+public:
+    explicit ScreenDiffBuffer(std::streambuf* out, int fd = STDOUT_FILENO)
+        : target(out), height(24), validRows(0), composing(false), clearMatched(0) {
+        struct winsize size;
+        if (::ioctl(fd, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+            height = size.ws_row;
+        }
+    }
+
+    ~ScreenDiffBuffer() override {
+        if (composing) {
+            render();
+        }
     }
 };
 
+// Discards everything written to it (used for quiet headless sessions)
+class NullStream : public std::ostream {
+public:
+    NullStream() : std::ostream(nullptr) {}
+};
+
 class Game {
 private:
-    std::unique_ptr<Player> player;
-    std::vector<Location> locations;
+    // Owns the player and items of this session
+    Arena arena;
+    // Where run() reads input; sessions fed through feed() have none
+    std::istream* in;
+    std::ostream& out;
+    // What out words its messages with
+    std::shared_ptr<const TextTable> text;
+    bool headless;
+    uint64_t seed;
+    Rng rng;
+    std::vector<uint64_t> combatSeeds;
+    std::shared_ptr<const WorldData> world;
+    // The player and the enemies
+    EntityStore entities;
+    Player* player;
+    // Null unless the session plays in a shared station
+    SharedStation* station;
+    SharedStation::Occupant occupant;
+    LocationStore locations;
     bool gameOver;
     int currentLocation;
     std::vector<Quest> quests;
     std::queue<std::string> messageLog;
-    std::vector<std::shared_ptr<CombatEntity>> enemies;
+    // In world order
+    std::vector<EntityId> enemies;
+    // Reused by every fight of the session
+    Combat::CombatTable combatTable;
     bool hasEscaped;
+    std::string savePath;
+    // Sections as last written to the save file, by tag and index, to diff
+    // the next checkpoint against
+    std::map<std::pair<uint16_t, uint16_t>, std::string> savedSections;
+    uint32_t saveSequence;
+    size_t fullSaveBytes;
+    size_t deltaSaveBytes;
+    SessionJournal* journal;
+    // Input received but not read yet. Once it has ended, every read is
+    // answered, at worst with the end of the input.
+    std::string input;
+    size_t inputPos;
+    bool inputEnded;
+    // Time spent blocked on input, which telemetry spans leave out
+    uint64_t inputWaitNs;
+    std::chrono::steady_clock::time_point suspendedAt;
+
+    // Records the game work done while it is alive into a telemetry
+    // histogram, not counting any time spent waiting for input
+    class Span {
+    private:
+        const Game& game;
+        Telemetry::Metric metric;
+        std::chrono::steady_clock::time_point start;
+        uint64_t waitedBefore;
+
+    public:
+        Span(const Game& g, Telemetry::Metric m)
+            : game(g), metric(m), start(), waitedBefore(g.inputWaitNs) {
+            if (Telemetry::enabled()) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Span() { finish(); }
+
+        // Records now instead of at the end of the scope
+        void finish() {
+            if (start.time_since_epoch().count() != 0 && Telemetry::enabled()) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                uint64_t waited = game.inputWaitNs - waitedBefore;
+                Telemetry::record(metric, static_cast<uint64_t>(elapsed) > waited ? elapsed - waited : 0);
+            }
+            start = std::chrono::steady_clock::time_point();
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    };
+
+    // Where the session stands between inputs. A stage that waits for input
+    // has printed its prompt already, so resuming it only reads.
+    enum class Stage {
+        NAME,
+        OPENING,
+        TURN,               // save, then show the location and the options
+        MENU_CHOICE,
+        MOVE_CHOICE,
+        INTERACT_CHOICE,
+        PICKUP_CHOICE,
+        INTERACT_TRIGGERS,  // fired by the chosen interaction
+        PICKUP_TRIGGERS,    // fired by using the item picked up
+        TURN_TRIGGERS,
+        PAUSE,              // "Press Enter to continue"
+        TURN_END,
+        FINISHED
+    };
+
+    // A fight started by a trigger's FIGHT action
+    struct Fight {
+        EntityId enemy;
+        uint32_t self;
+        uint32_t foe;
+        Rng rng;
+        // The attack menu is shown; the player's move is next
+        bool prompted;
+    };
+
+    // Triggers being fired: those not tested yet, and the actions left of
+    // the one that is running. A fight an action starts holds up the rest.
+    struct TriggerRun {
+        const uint32_t* next;
+        const uint32_t* last;
+        uint32_t pc;
+        uint32_t end;
+    };
+
+    Stage stage = Stage::NAME;
+    std::optional<TriggerRun> triggerRun;
+    std::optional<Fight> fight;
+    std::optional<Span> turnSpan;
+    std::optional<Span> pickupSpan;
+    std::optional<Span> combatSpan;
+
+    // The world clock and what it drives between inputs. A tick visits only
+    // what still has something to do: the entities regenerating, the patrols
+    // of enemies still standing, and the timers that have not gone off.
+    uint64_t clock = 0;
+    uint32_t nextTimer = 0;
+    // Where each of the world's patrols is, in world order
+    std::vector<SaveFormat::PatrolState> patrols;
+    std::vector<EntityId> recovering;
+    std::vector<uint32_t> walking;
+    // Locations the player has been in, and how many
+    std::vector<bool> visited;
+    uint32_t explored = 0;
+    // The items listed by the pickup menu the player is answering, which in
+    // a shared station may be gone from the room by the time they choose
+    std::vector<std::pair<Item*, ItemHandle>> offered;
+
+    static Telemetry::Metric turnMetric(int choice) {
+        static const Telemetry::Metric metrics[] = {
+            Telemetry::TURN_MOVE, Telemetry::TURN_INTERACT, Telemetry::TURN_PICKUP,
+            Telemetry::TURN_INVENTORY, Telemetry::TURN_STATUS, Telemetry::TURN_QUIT
+        };
+        return choice >= 1 && choice <= 6 ? metrics[choice - 1] : Telemetry::TURN_INVALID;
+    }
+
+    void typewriter(std::string_view text) {
+        typewriterEffect(out, text, headless ? 0 : 30);
+    }
+
+    // Types out a message, formatted straight into the typewriter's queue
+    template<typename... Args>
+    void typewriter(Text::Id id, const Args&... args) {
+        TypedLine line(out, headless ? 0 : 30);
+        Text::print(out, id, args...);
+    }
+
+    // Ends the current frame: the screen composed so far goes out at once
+    void present() {
+        Span render(*this, Telemetry::RENDER);
+        out.flush();
+    }
+
+    // Any input from the player fast-forwards pending typewriter text
+    void skipAnimation() {
+        if (auto* animated = dynamic_cast<TypewriterBuffer*>(out.rdbuf())) {
+            animated->skip();
+        }
+    }
+
+    std::string_view pending() const {
+        return std::string_view(input).substr(inputPos);
+    }
+
+    void consume(size_t count) {
+        inputPos += count;
+        if (inputPos == input.size()) {
+            input.clear();
+            inputPos = 0;
+        }
+    }
+
+    // Whether readChoice() can be answered yet. Like `in >> choice` it
+    // skips blank lines, and it reads on to the end of the line it stops in.
+    bool choiceReady() const {
+        std::string_view rest = pending();
+        size_t start = 0;
+        while (start < rest.size() && std::isspace(static_cast<unsigned char>(rest[start]))) {
+            ++start;
+        }
+        return inputEnded || rest.find('\n', start) != std::string_view::npos;
+    }
+
+    bool lineReady() const {
+        return inputEnded || pending().find('\n') != std::string_view::npos;
+    }
+
+    bool characterReady() const {
+        return inputEnded || !pending().empty();
+    }
+
+    // Reads a numeric choice the way `in >> choice` and skipping the rest of
+    // the line would; anything that is not a number reads as 0. Returns
+    // false once the input is exhausted.
+    bool readChoice(int& choice) {
+        std::string_view rest = pending();
+        size_t at = 0;
+        while (at < rest.size() && std::isspace(static_cast<unsigned char>(rest[at]))) {
+            ++at;
+        }
+        bool negative = at < rest.size() && rest[at] == '-';
+        if (at < rest.size() && (rest[at] == '-' || rest[at] == '+')) {
+            ++at;
+        }
+        size_t digits = at;
+        int64_t value = 0;
+        while (at < rest.size() && std::isdigit(static_cast<unsigned char>(rest[at]))) {
+            value = std::min<int64_t>(value * 10 + (rest[at] - '0'), int64_t(1) << 32);
+            ++at;
+        }
+        value = negative ? -value : value;
+        bool valid = at > digits && value >= std::numeric_limits<int>::min() &&
+                     value <= std::numeric_limits<int>::max();
+        if (!valid && at == rest.size()) {
+            consume(rest.size());
+            gameOver = true;
+            return false;
+        }
+        choice = valid ? static_cast<int>(value) : 0;
+        size_t newline = rest.find('\n', at);
+        consume(newline == std::string_view::npos ? rest.size() : newline + 1);
+        return true;
+    }
+
+    // Reads a line like std::getline(in, line)
+    std::string readLine() {
+        std::string_view rest = pending();
+        size_t newline = rest.find('\n');
+        std::string line(rest.substr(0, newline));
+        consume(newline == std::string_view::npos ? rest.size() : newline + 1);
+        return line;
+    }
+
+    // Reads one character like in.get(); false at the end of the input
+    bool readCharacter() {
+        if (pending().empty()) {
+            return false;
+        }
+        consume(1);
+        return true;
+    }
+
+    // Blocks on the input stream for the next line
+    void pull() {
+        std::string line;
+        if (std::getline(*in, line)) {
+            if (!in->eof()) {
+                line.push_back('\n');
+            }
+            feed(line);
+        } else {
+            endInput();
+        }
+    }
+
+    // The frame goes out before the session waits for more input
+    bool suspend() {
+        present();
+        if (Telemetry::enabled()) {
+            suspendedAt = std::chrono::steady_clock::now();
+        }
+        return true;
+    }
 
     void displayTitle() {
-        std::cout << AnsiArt::CLEAR_SCREEN;
-        std::cout << AnsiArt::BLUE;
-        AnsiArt::printCentered("================================");
-        AnsiArt::printCentered("SPACE DYSTOPIA: THE LAST FRONTIER");
-        AnsiArt::printCentered("================================");
-        AnsiArt::AsciiArt::drawSpacestation();
-        std::cout << AnsiArt::RESET << std::endl;
+        out << AnsiArt::CLEAR_SCREEN;
+        out << AnsiArt::BLUE;
+        AnsiArt::printCentered(out, "================================");
+        AnsiArt::printCentered(out, (*text)[Text::TITLE]);
+        AnsiArt::printCentered(out, "================================");
+        AnsiArt::AsciiArt::drawSpacestation(out);
+        out << AnsiArt::RESET << '\n';
     }
 
     
     void displayendTitle() {
-        std::cout << AnsiArt::CLEAR_SCREEN;
-        std::cout << AnsiArt::BLUE;
-        AnsiArt::printCentered("================================");
-        AnsiArt::printCentered("BYEEEEEE!");
-        AnsiArt::printCentered("================================");
-        typewriterEffect( player->getName() + ", will meet again soon.");
-        std::cout << AnsiArt::RESET << std::endl;
+        out << AnsiArt::CLEAR_SCREEN;
+        out << AnsiArt::BLUE;
+        AnsiArt::printCentered(out, "================================");
+        AnsiArt::printCentered(out, (*text)[Text::FAREWELL]);
+        AnsiArt::printCentered(out, "================================");
+        typewriter(Text::FAREWELL_LINE, player->getName());
+        out << AnsiArt::RESET << '\n';
     }
 
     void initializeQuests() {
         Quest mainQuest("Escape Europa", "Find a way to escape and reveal the truth");
-        mainQuest.addObjective("Access classified data", 1);
-        mainQuest.addObjective("Bypass security", 1);
-        mainQuest.addObjective("Escape via airlock", 1);
+        mainQuest.addFlagObjective("Access classified data",
+            {Names::READ_CLASSIFIED_INFO, Names::TOUCHED_MONOLITH, Names::SPACESUIT_EQUIPPED});
+        mainQuest.addFlagObjective("Bypass security", {Names::SECURITY_DEFEATED});
+        mainQuest.addFlagObjective("Escape via airlock", {Names::AIRLOCK_ESCAPED});
         quests.push_back(mainQuest);
+
+        // Track only once the vector is final, the listeners point into it
+        for (auto& quest : quests) {
+            quest.track(player->getQuestFlags());
+        }
     }
 
     void initializeEnemies() {
-        auto securityBot = std::make_shared<Enemy>("Security Bot", "Robot", 50, 10, 3);
-        auto eliteGuard = std::make_shared<Enemy>("Elite Guard Bot", "Robot", 75, 15, 5);
-        enemies.push_back(securityBot);
-        enemies.push_back(eliteGuard);
-    }
-
-    void initializeLocations() {
-        locations = {
-            Location("Maintenance Bay", "A sterile white room filled with repair equipment."),
-            Location("Terminal Room", "A quiet room with a terminal. Red light pulses steadily."),
-            Location("Security Post", "A heavily guarded area with advanced security bots."),
-            Location("Airlock", "The gateway between the station and the void of space.")
-        };
+        for (const auto& def : world->enemies) {
+            enemies.push_back(entities.createEnemy(def.name, def.type, def.health, def.attack, def.defense));
+        }
+        for (const auto& def : world->patrols) {
+            patrols.push_back({def.waypoints[0], static_cast<uint32_t>(1 % def.waypoints.size()), 0});
+        }
+    }
 
+    // Puts what the world clock has to act on into the active sets
+    void wakeAll() {
+        for (EntityId entity = 0; entity < entities.size(); ++entity) {
+            recover(entity);
+        }
+        walking.clear();
+        for (uint32_t index = 0; index < patrols.size(); ++index) {
+            if (world->patrols[index].waypoints.size() > 1 && alive(enemies[world->patrols[index].enemy])) {
+                walking.push_back(index);
+            }
+        }
+    }
 
-        auto datapad = std::make_shared<Item>("Datapad", "A tablet containing classified information", true);
-        auto keycard = std::make_shared<Item>("Keycard", "A security keycard", true);
-        auto spacesuit = std::make_shared<Item>("Spacesuit", "Required for space travel", true);
-        auto emp = std::make_shared<Item>("EMP Device", "Can disable security systems", true);
+    bool alive(EntityId entity) const {
+        return entities.stats[entity].get<Stats::HEALTH>() > 0;
+    }
 
+    // Lets an entity that is short of a stat regenerate on the next ticks
+    void recover(EntityId entity) {
+        if (alive(entity) && entities.stats[entity].recovering() &&
+            std::find(recovering.begin(), recovering.end(), entity) == recovering.end()) {
+            recovering.push_back(entity);
+        }
+    }
 
-        
-        // Create items with detailed use effects
-        datapad->setUseEffect([this]() {
-            std::cout << "You carefully read through the classified information..." << std::endl;
-            std::cout << "The data reveals coordinates for a potentially habitable planet beyond Pluto." << std::endl;
-            player->setQuestFlag("read_classified_info");
-            player->gainExperience(20);
-        }, "Access classified information about the mysterious signals");
-
-
-        keycard->setUseEffect([this]() {
-            if (currentLocation == 1) { // Terminal Room
-                std::cout << "You swipe the keycard through the terminal..." << std::endl;
-                player->setQuestFlag("terminal_access_granted");
-                player->gainExperience(15);
-            } else {
-                std::cout << "There's nowhere to use the keycard here." << std::endl;
+    // Moves a patrol on by the ticks that passed, one room per ticksPerRoom,
+    // and tells the player about it coming or going. Returns whether
+    // anything was printed.
+    bool walk(uint32_t index, uint64_t ticks) {
+        const WorldData::PatrolDef& def = world->patrols[index];
+        SaveFormat::PatrolState& state = patrols[index];
+        const std::string& name = entities.identity[enemies[def.enemy]].name;
+        bool shown = false;
+        uint64_t progress = state.progress + ticks;
+        for (; progress >= def.ticksPerRoom; progress -= def.ticksPerRoom) {
+            uint32_t target = def.waypoints[state.waypoint];
+            uint32_t from = state.room;
+            if (from != target) {
+                state.room = world->map.hasExits() ? world->map.nextHop(from, target) : target;
             }
-        }, "Use at terminals to gain access");
-
-        spacesuit->setUseEffect([this]() {
-            if (currentLocation == 3) { // Airlock
-                std::cout << "You put on the spacesuit, checking all seals..." << std::endl;
-                player->setQuestFlag("spacesuit_equipped");
-                player->gainExperience(10);
-            } else {
-                std::cout << "You should wait until you're at the airlock." << std::endl;
+            if (state.room == target) {
+                state.waypoint = static_cast<uint32_t>((state.waypoint + 1) % def.waypoints.size());
+            }
+            if (state.room == from) {
+                continue;
             }
-        }, "Required for EVA activities");
+            if (from == static_cast<uint32_t>(currentLocation)) {
+                Text::line(out, Text::PATROL_LEAVES, name, world->locations[state.room].name);
+                shown = true;
+            } else if (state.room == static_cast<uint32_t>(currentLocation)) {
+                Text::line(out, Text::PATROL_ARRIVES, name, world->locations[from].name);
+                shown = true;
+            }
+        }
+        state.progress = static_cast<uint32_t>(progress);
+        return shown;
+    }
+
+    // Creates the item at index in the world's item list; what using it
+    // does is left to the world's triggers
+    Item* createItem(uint32_t index) {
+        auto item = arena.make<Item>(world->items[index]);
+        item->makeAvailable();
+        return item;
+    }
+
+    // Fires the world's triggers for an event; runTriggers() runs them
+    void fireTriggers(TriggerEvent event, uint32_t subject) {
+        auto range = world->script.on(event, subject);
+        triggerRun = TriggerRun{range.first, range.second, 0, 0};
+    }
 
+    // Runs the triggers being fired, stopping once one of them has ended the
+    // game. Returns false while a fight one of them started waits for input.
+    bool runTriggers() {
+        const TriggerProgram& script = world->script;
+        while (triggerRun) {
+            if (fight && !runFight()) {
+                return false;
+            }
+            TriggerRun& run = *triggerRun;
+            if (run.pc < run.end) {
+                execute(script.at(run.pc++));
+                continue;
+            }
+            if (run.next == run.last || gameOver) {
+                triggerRun.reset();
+                break;
+            }
+            const auto& trigger = script.trigger(*run.next++);
+            if (applies(trigger)) {
+                run.pc = trigger.actions;
+                run.end = trigger.end;
+            }
+        }
+        return true;
+    }
 
-        // Add items to locations
-        locations[0].addItem(datapad);
-        locations[1].addItem(keycard);
-        locations[3].addItem(spacesuit);
-        locations[2].addItem(emp);
+    // Whether all of a trigger's conditions hold
+    bool applies(const TriggerProgram::Trigger& trigger) const {
+        uint32_t pc = trigger.begin;
+        while (pc < trigger.actions && holds(world->script.at(pc))) {
+            ++pc;
+        }
+        return pc == trigger.actions;
+    }
 
-        locations[0].getItemByName("Datapad")->makeAvailable();
-        locations[1].getItemByName("Keycard")->makeAvailable();
-        locations[2].getItemByName("EMP Device")->makeAvailable();
-        locations[3].getItemByName("Spacesuit")->makeAvailable();
+    bool holds(const TriggerProgram::Instruction& condition) const {
+        bool result = false;
+        switch (condition.op) {
+            case TriggerOp::AT: result = currentLocation == static_cast<int>(condition.arg); break;
+            case TriggerOp::FLAG: result = player->hasQuestFlag(condition.arg); break;
+            case TriggerOp::HAS: result = player->hasItem(condition.arg); break;
+            default: break;
+        }
+        return result != condition.negate;
+    }
 
-        locations[0].addInteraction("examine workbench",
-            "You find various repair tools and a hidden datapad.");
-        
-        // Single hack terminal interaction
-        locations[1].addInteraction("hack terminal", 
-            "You begin hacking the terminal... Security has been alerted!");
-        locations[1].addInteraction("examine terminal",
-            "The terminal displays various system diagnostics.");
-        
-        locations[2].addInteraction("examine security",
-            "The security systems are active but might be vulnerable to EMPs.");
-        
-        locations[3].addInteraction("check airlock",
-            "The airlock appears functional. A spacesuit would be required for EVA.");
-        locations[3].addInteraction("activate airlock",
-            "The airlock cycles... This is your chance to escape!");
+    void execute(const TriggerProgram::Instruction& action) {
+        switch (action.op) {
+            case TriggerOp::SAY: out << action.text << '\n'; break;
+            case TriggerOp::TYPE: typewriter(action.text); break;
+            case TriggerOp::SET_FLAG: player->setQuestFlag(action.arg); break;
+            case TriggerOp::XP: player->gainExperience(static_cast<int>(action.arg), out); break;
+            case TriggerOp::FIGHT:
+                // An enemy already defeated stays down
+                if (alive(enemies[action.arg])) {
+                    startFight(enemies[action.arg]);
+                }
+                break;
+            case TriggerOp::ESCAPE:
+                hasEscaped = true;
+                gameOver = true;
+                break;
+            default: break;
+        }
     }
 
 
@@ -647,331 +4669,2075 @@ private:
         locations[3].addInteraction("activate airlock",
             "The airlock cycles... This is your chance to escape!");
     }
-    */
+    */
+
+    bool checkWinCondition() {
+        return player->hasQuestFlag(Names::READ_CLASSIFIED_INFO) && 
+               player->hasQuestFlag(Names::TERMINAL_HACKED) &&
+               player->hasQuestFlag(Names::SECURITY_DEFEATED) && 
+               player->hasQuestFlag(Names::SPACESUIT_EQUIPPED);
+    }
+
+    // Moves the player, and in a shared station where the others see them
+    void travelTo(int destination) {
+        int from = currentLocation;
+        walkTo(destination);
+        if (station && currentLocation != from) {
+            station->leave(static_cast<uint32_t>(from), occupant);
+            station->enter(static_cast<uint32_t>(currentLocation), occupant, player->getName());
+        }
+    }
+
+    // Walks the shortest route through the station's exits, one step per
+    // room entered. Worlds that define no exits keep the old free movement.
+    void walkTo(int destination) {
+        const StationMap& map = world->map;
+        if (!map.hasExits()) {
+            currentLocation = destination;
+            visit(currentLocation);
+            player->incrementSteps();
+            Telemetry::count(Telemetry::STEPS);
+            return;
+        }
+        uint32_t from = static_cast<uint32_t>(currentLocation);
+        uint32_t to = static_cast<uint32_t>(destination);
+        if (map.distance(from, to) == StationMap::UNREACHABLE) {
+            Text::line(out, Text::NO_ROUTE, world->locations[destination].name);
+            return;
+        }
+        if (map.distance(from, to) > 1) {
+            Text::print(out, Text::ROUTE, world->locations[from].name);
+            for (uint32_t here = map.nextHop(from, to); ; here = map.nextHop(here, to)) {
+                Text::print(out, Text::ROUTE_STEP, world->locations[here].name);
+                if (here == to) {
+                    break;
+                }
+            }
+            out << '\n';
+        }
+        while (currentLocation != destination) {
+            currentLocation = static_cast<int>(map.nextHop(static_cast<uint32_t>(currentLocation), to));
+            visit(currentLocation);
+            player->incrementSteps();
+            Telemetry::count(Telemetry::STEPS);
+        }
+    }
+
+    void visit(int location) {
+        if (!visited[location]) {
+            visited[location] = true;
+            explored++;
+        }
+    }
+
+    void interact(InteractionId key) {
+        typewriter(locations[currentLocation].interact(key, player, *text));
+    }
+
+    // Fights on the player's and the enemy's own stat rows, so damage dealt
+    // and taken carries over past the fight. runFight() plays the rounds.
+    void startFight(EntityId enemy) {
+        combatSpan.emplace(*this, Telemetry::COMBAT);
+        Text::line(out, Text::COMBAT_START, entities.identity[enemy].name);
+
+        // Every fight gets its own recorded seed so it can be replayed on its own
+        uint64_t combatSeed = rng.next();
+        combatSeeds.push_back(combatSeed);
+        if (journal) {
+            journal->combatSeed(combatSeed);
+        }
+
+        combatTable.clear();
+        const uint32_t self = combatTable.add(entities.stats[player->getEntity()]);
+        const uint32_t foe = combatTable.add(entities.stats[enemy]);
+        fight = Fight{enemy, self, foe, Rng(combatSeed), false};
+    }
+
+    // Returns false while waiting for the player's next move
+    bool runFight() {
+        Fight& current = *fight;
+        const std::string& enemyName = entities.identity[current.enemy].name;
+        StatBlock& hero = entities.stats[player->getEntity()];
+        StatBlock& foeStats = entities.stats[current.enemy];
+        const uint32_t self = current.self;
+        const uint32_t foe = current.foe;
+
+        while (combatTable.isAlive(foe) && combatTable.isAlive(self)) {
+            // Player turn
+            if (!current.prompted) {
+                Text::print(out, Text::ATTACK_MENU);
+                current.prompted = true;
+            }
+            if (!choiceReady()) {
+                return false;
+            }
+            current.prompted = false;
+            int choice;
+            if (!readChoice(choice)) {
+                endFight();
+                return true;
+            }
+
+            Combat::Strike strike{self, foe, 1};
+            if (choice == 2 && player->hasItem(Names::EMP_DEVICE)) {
+                // EMP does extra damage to robots
+                strike.multiplier = 2;
+                Text::line(out, Text::EMP_DEPLOYED);
+            }
+            else if (choice == 1 ) {
+                Text::line(out, Text::NORMAL_ATTACK);
+            }
+            else {
+                Text::line(out, Text::NO_EMP);
+            }
+
+            int playerDamage = 0;
+            combatTable.resolve(&strike, 1, current.rng, &playerDamage);
+            foeStats.set<Stats::HEALTH>(combatTable.health[foe]);
+            typewriter(Text::PLAYER_DAMAGE, playerDamage);
+
+
+            if (!combatTable.isAlive(foe)) {
+                Telemetry::count(Telemetry::COMBATS_WON);
+                typewriter(Text::ENEMY_DEFEATED, enemyName);
+                player->setQuestFlag(Names::SECURITY_DEFEATED);
+                player->gainExperience(50, out);
+                player->display(out);
+            }
+
+                // Enemy turn
+            if (choice != 2 && !player->hasItem("EMP") && combatTable.isAlive(foe)) {
+                Combat::Strike counter{foe, self, 1};
+                int enemyDamage = 0;
+                combatTable.resolve(&counter, 1, current.rng, &enemyDamage);
+                hero.set<Stats::HEALTH>(combatTable.health[self]);
+                typewriter(Text::ENEMY_DAMAGE, enemyName, enemyDamage);
+
+            }
+            Text::line(out, Text::PLAYER_HEALTH, combatTable.health[self]);
+            Text::line(out, Text::ENEMY_HEALTH, enemyName, combatTable.health[foe]);
+        }
+        if (!combatTable.isAlive(self)) {
+            Telemetry::count(Telemetry::COMBATS_LOST);
+            typewriter(Text::PLAYER_DEFEATED, enemyName);
+            gameOver = true;
+        }
+        endFight();
+        return true;
+    }
+
+    void endFight() {
+        recover(player->getEntity());
+        recover(fight->enemy);
+        fight.reset();
+        combatSpan.reset();
+    }
+
+    std::string encodeItems(const std::vector<uint32_t>& list) const {
+        std::string payload;
+        for (uint32_t index : list) {
+            WorldFormat::append(payload, index);
+        }
+        return payload;
+    }
+
+    // Encodes the session as save sections; rooms never touched are left out
+    std::vector<std::string> encodeSections() {
+        using namespace SaveFormat;
+        std::vector<std::string> sections;
+
+        SessionRecord session;
+        session.seed = seed;
+        rng.saveState(session.rngState);
+        session.currentLocation = currentLocation;
+        session.combatCount = static_cast<uint32_t>(combatSeeds.size());
+        std::string payload;
+        WorldFormat::append(payload, session);
+        for (uint64_t combatSeed : combatSeeds) {
+            WorldFormat::append(payload, combatSeed);
+        }
+        sections.push_back(section(SESSION, 0, payload));
+
+        PlayerRecord record{};
+        record.health = player->getHealth().getCurrent();
+        record.energy = player->getEnergy().getCurrent();
+        record.experience = player->getExperience();
+        record.totalSteps = player->getTotalSteps();
+        record.itemsCollected = player->getItemsCollected();
+        record.nameLength = static_cast<uint32_t>(player->getName().size());
+        const auto& flags = player->getQuestFlags().raw();
+        for (size_t i = 0; i < MAX_QUEST_FLAGS; ++i) {
+            if (flags.test(i)) {
+                record.flags[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+        payload.clear();
+        WorldFormat::append(payload, record);
+        payload += player->getName();
+        sections.push_back(section(PLAYER, 0, payload));
+
+        std::vector<uint32_t> inventory;
+        for (const Item* item : player->getInventory()) {
+            inventory.push_back(locations.indexOf(item));
+        }
+        sections.push_back(section(INVENTORY, 0, encodeItems(inventory)));
+
+        payload.clear();
+        for (EntityId enemy : enemies) {
+            WorldFormat::append(payload, int32_t(entities.stats[enemy].get<Stats::HEALTH>()));
+        }
+        sections.push_back(section(ENEMIES, 0, payload));
+
+        // Rooms never touched still hold what the world gives them
+        for (uint32_t room : locations.touched()) {
+            sections.push_back(section(LOCATION_ITEMS, static_cast<uint16_t>(room), encodeItems(locations.itemsIn(room))));
+        }
+
+        payload.clear();
+        WorldFormat::append(payload, ClockRecord{clock, nextTimer, 0});
+        for (const auto& patrol : patrols) {
+            WorldFormat::append(payload, patrol);
+        }
+        sections.push_back(section(CLOCK, 0, payload));
+
+        std::vector<uint32_t> rooms;
+        for (uint32_t room = 0; room < visited.size(); ++room) {
+            if (visited[room]) {
+                rooms.push_back(room);
+            }
+        }
+        sections.push_back(section(VISITED, 0, encodeItems(rooms)));
+        return sections;
+    }
+
+    // Writes the session to the save file. The first checkpoint, and any
+    // after the appended deltas have outgrown a full snapshot, rewrites the
+    // file with one full frame; the others append only what changed.
+    void checkpoint() {
+        using namespace SaveFormat;
+        std::map<std::pair<uint16_t, uint16_t>, std::string> sections;
+        for (auto& encoded : encodeSections()) {
+            SectionHeader key;
+            std::memcpy(&key, encoded.data(), sizeof(key));
+            sections[{key.tag, key.index}] = std::move(encoded);
+        }
+        bool full = savedSections.empty() || deltaSaveBytes > fullSaveBytes;
+
+        std::string body;
+        uint32_t count = 0;
+        for (const auto& [key, encoded] : sections) {
+            auto saved = savedSections.find(key);
+            if (full || saved == savedSections.end() || saved->second != encoded) {
+                body += encoded;
+                count++;
+            }
+        }
+        if (count == 0) {
+            return;
+        }
+
+        FrameHeader header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.kind = full ? FULL : DELTA;
+        header.sequence = ++saveSequence;
+        header.frameBytes = static_cast<uint32_t>(sizeof(FrameHeader) + body.size());
+        header.sectionCount = count;
+        header.locationCount = static_cast<uint32_t>(world->locations.size());
+        header.itemCount = static_cast<uint32_t>(world->items.size());
+        header.enemyCount = static_cast<uint32_t>(world->enemies.size());
+        std::string frame;
+        WorldFormat::append(frame, header);
+        frame += body;
+
+        if (full) {
+            // Written aside and renamed over, so a crash never leaves half a snapshot
+            std::string temporary = savePath + ".tmp";
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(frame.data(), frame.size());
+            file.close();
+            if (!file || std::rename(temporary.c_str(), savePath.c_str()) != 0) {
+                throw std::runtime_error("Cannot write save file " + savePath);
+            }
+            fullSaveBytes = frame.size();
+            deltaSaveBytes = 0;
+        } else {
+            std::ofstream file(savePath, std::ios::binary | std::ios::app);
+            file.write(frame.data(), frame.size());
+            if (!file) {
+                throw std::runtime_error("Cannot append to save file " + savePath);
+            }
+            deltaSaveBytes += frame.size();
+        }
+        savedSections = std::move(sections);
+    }
+
+    // Puts the freshly initialized session into the state the sections describe
+    void restore(const std::vector<SaveFormat::Section>& sections) {
+        using namespace SaveFormat;
+        auto item = [this](uint32_t index) {
+            if (index >= world->items.size()) {
+                throw std::runtime_error("Save file item out of range");
+            }
+            return locations.item(index);
+        };
+
+        for (const auto& section : sections) {
+            size_t offset = 0;
+            switch (section.tag) {
+                case SESSION: {
+                    auto record = read<SessionRecord>(section.payload, offset);
+                    auto saved = readArray<uint64_t>(section.payload.substr(offset));
+                    if (record.currentLocation < 0 || record.currentLocation >= static_cast<int>(locations.size()) ||
+                        saved.size() != record.combatCount) {
+                        throw std::runtime_error("Save file session is corrupt");
+                    }
+                    seed = record.seed;
+                    rng.loadState(record.rngState);
+                    currentLocation = record.currentLocation;
+                    combatSeeds = std::move(saved);
+                    break;
+                }
+                case PLAYER: {
+                    auto record = read<PlayerRecord>(section.payload, offset);
+                    player->setVitals(record.health, record.energy);
+                    player->setProgress(record.experience, record.totalSteps, record.itemsCollected);
+                    std::bitset<MAX_QUEST_FLAGS> flags;
+                    for (size_t i = 0; i < MAX_QUEST_FLAGS; ++i) {
+                        flags.set(i, (record.flags[i / 64] >> (i % 64)) & 1);
+                    }
+                    // Flag-driven quest objectives catch up through their listeners
+                    player->getQuestFlags().assign(flags);
+                    break;
+                }
+                case INVENTORY:
+                    for (uint32_t index : readArray<uint32_t>(section.payload)) {
+                        player->addItem(item(index));
+                    }
+                    break;
+                case ENEMIES: {
+                    auto health = readArray<int32_t>(section.payload);
+                    for (size_t i = 0; i < std::min(health.size(), enemies.size()); ++i) {
+                        entities.stats[enemies[i]].set<Stats::HEALTH>(health[i]);
+                    }
+                    break;
+                }
+                case LOCATION_ITEMS:
+                    if (section.index >= locations.size()) {
+                        throw std::runtime_error("Save file location out of range");
+                    }
+                    for (uint32_t index : readArray<uint32_t>(section.payload)) {
+                        item(index);
+                    }
+                    locations.setItems(section.index, readArray<uint32_t>(section.payload));
+                    break;
+                case CLOCK: {
+                    auto record = read<ClockRecord>(section.payload, offset);
+                    auto saved = readArray<PatrolState>(section.payload.substr(offset));
+                    for (size_t i = 0; i < std::min(saved.size(), patrols.size()); ++i) {
+                        if (saved[i].room >= locations.size() ||
+                            saved[i].waypoint >= world->patrols[i].waypoints.size()) {
+                            throw std::runtime_error("Save file patrol is corrupt");
+                        }
+                        patrols[i] = saved[i];
+                    }
+                    clock = record.tick;
+                    nextTimer = record.nextTimer;
+                    break;
+                }
+                case VISITED:
+                    for (uint32_t room : readArray<uint32_t>(section.payload)) {
+                        if (room >= locations.size()) {
+                            throw std::runtime_error("Save file location out of range");
+                        }
+                        visit(static_cast<int>(room));
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+public:
+    // Constructor with initialization list demonstrating exception handling.
+    // A headless game skips typewriter delays and "Press Enter" pauses so
+    // scripted sessions run at full speed.
+    // This session is fed its input through feed(), and step() plays as
+    // far as the input allows, so a session waiting for its player holds
+    // no thread.
+    Game(std::ostream& output, const GameOptions& options = GameOptions(),
+         std::shared_ptr<const WorldData> worldData = WorldData::builtin())
+        : in(nullptr), out(output), text(options.text ? options.text : TextTable::builtin()),
+          headless(options.headless),
+          seed(options.seed ? *options.seed : (uint64_t(std::random_device()()) << 32) | std::random_device()()),
+          rng(seed), world(std::move(worldData)), player(nullptr), station(options.station),
+          occupant(station ? station->join() : 0),
+          locations(world, [this](uint32_t index) { return createItem(index); }, options.residentLocations,
+                    station),
+          gameOver(false), currentLocation(0), hasEscaped(false), savePath(options.savePath),
+          saveSequence(0), fullSaveBytes(0), deltaSaveBytes(0), journal(options.journal),
+          inputPos(0), inputEnded(false), inputWaitNs(0) {
+        if (station && &station->worldData() != world.get()) {
+            throw std::invalid_argument("A shared station must be of the session's world");
+        }
+        if (journal) {
+            journal->begin(seed, headless, station != nullptr);
+        }
+        TextTable::use(out, text.get());
+        displayTitle();
+
+        // An existing save is mapped and read in place; its views are
+        // only needed until restore()
+        struct stat info;
+        if (!savePath.empty() && ::stat(savePath.c_str(), &info) == 0 && info.st_size > 0) {
+            MappedFile saveFile(savePath);
+            auto saved = SaveFormat::readSections(saveFile.bytes(), saveFile.length(), *world);
+            if (!saved.empty()) {
+                std::string playerName = SaveFormat::playerName(saved);
+                Text::line(out, Text::RESUMING, playerName);
+                begin(playerName, saved);
+                return;
+            }
+        }
+        Text::print(out, Text::NAME_PROMPT);
+    }
+
+    // This session reads its input from a stream, blocking in run() until
+    // the player types
+    Game(std::istream& input = std::cin, std::ostream& output = std::cout,
+         const GameOptions& options = GameOptions(),
+         std::shared_ptr<const WorldData> worldData = WorldData::builtin())
+        : Game(output, options, std::move(worldData)) {
+        in = &input;
+        while (stage == Stage::NAME) {
+            if (lineReady()) {
+                acceptName();
+            } else {
+                present();
+                pull();
+            }
+        }
+    }
+
+    // Leaves the shared station, if the session was in one, and lets the
+    // stream forget the session's text table
+    ~Game() {
+        if (station && player) {
+            station->leave(static_cast<uint32_t>(currentLocation), occupant);
+        }
+        TextTable::use(out, nullptr);
+    }
+
+    Game(const Game&) = delete;
+    Game& operator=(const Game&) = delete;
+
+    // Words everything printed from now on with another table. Tables are
+    // loaded once and shared, so switching is only a pointer swap.
+    void setText(std::shared_ptr<const TextTable> table) {
+        text = table ? std::move(table) : TextTable::builtin();
+        TextTable::use(out, text.get());
+    }
+
+    void displayLocation() {
+        out << AnsiArt::BLUE;
+        Text::print(out, Text::LOCATION, locations[currentLocation].getName());
+        out << AnsiArt::RESET << '\n';
+        out << locations[currentLocation].getDescription() << '\n';
+        for (uint32_t index = 0; index < patrols.size(); ++index) {
+            EntityId enemy = enemies[world->patrols[index].enemy];
+            if (patrols[index].room == static_cast<uint32_t>(currentLocation) && alive(enemy)) {
+                Text::line(out, Text::PATROLLING, entities.identity[enemy].name);
+            }
+        }
+        if (station) {
+            auto others = station->company(static_cast<uint32_t>(currentLocation), occupant);
+            for (size_t i = 0; i < others.size(); ++i) {
+                Text::print(out, i == 0 ? Text::ALSO_HERE : Text::ALSO_HERE_MORE, others[i]);
+            }
+            if (!others.empty()) {
+                out << '\n';
+            }
+        }
+
+        // Display available items
+        const Inventory& items = locations[currentLocation].getItems();
+        if (!items.empty()) {
+            Text::line(out, Text::YOU_SEE);
+            for (const auto& item : items) {
+                Text::line(out, Text::ITEM_ENTRY, item->getName(), item->getDescription());
+            }
+        }
+
+        // Display available interactions
+        Text::line(out, Text::POSSIBLE_INTERACTIONS);
+        for (const auto& interaction : locations[currentLocation].getAvailableInteractions()) {
+            Text::line(out, Text::LIST_ENTRY, interaction);
+        }
+    }
+
+    void displayEndGameStats() {
+        out << AnsiArt::YELLOW;
+        Text::print(out, Text::FINAL_STATISTICS);
+        out << AnsiArt::RESET << '\n';
+        player->display(out);
+
+        Text::line(out, Text::LOCATIONS_EXPLORED, explored, locations.size());
+        Text::line(out, Text::SESSION_SEED, seed);
+
+    }
+
+    uint64_t getSeed() const { return seed; }
+    const std::vector<uint64_t>& getCombatSeeds() const { return combatSeeds; }
+
+    // Input for a session created without an input stream
+    void feed(std::string_view text) {
+        input.append(text.data(), text.size());
+        skipAnimation();
+    }
+
+    // No more input will come; the session winds down at its next read
+    void endInput() {
+        inputEnded = true;
+    }
+
+    // Plays until the session needs input that has not arrived yet, then
+    // presents the frame. Returns false once the session is over.
+    bool step() {
+        if (stage == Stage::FINISHED) {
+            return false;
+        }
+        if (suspendedAt != std::chrono::steady_clock::time_point()) {
+            inputWaitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - suspendedAt).count();
+            suspendedAt = std::chrono::steady_clock::time_point();
+        }
+        if (stage == Stage::NAME) {
+            if (!lineReady()) {
+                return suspend();
+            }
+            acceptName();
+        }
+        try {
+            while (advance()) {
+            }
+            if (stage != Stage::FINISHED) {
+                return suspend();
+            }
+        }
+        catch (const std::exception& e) {
+            out << AnsiArt::RED;
+            Text::print(out, Text::ERROR, e.what());
+            out << AnsiArt::RESET << '\n';
+            stage = Stage::FINISHED;
+        }
+        present();
+        if (journal) {
+            journal->end();
+        }
+        return false;
+    }
+
+    // Plays the whole session, for sessions created with an input stream
+    void run() {
+        while (step()) {
+            pull();
+        }
+    }
+
+    // Throws std::logic_error naming the first thing about the session found
+    // inconsistent. It walks all of the session's state, so it is meant for
+    // the fuzzer, not for every turn.
+    void checkInvariants() const {
+        auto fail = [](const std::string& what) {
+            throw std::logic_error("Invariant broken: " + what);
+        };
+        for (EntityId entity = 0; entity < entities.stats.size(); ++entity) {
+            const StatBlock& block = entities.stats[entity];
+            const std::string& name = entities.identity[entity].name;
+            if (block.get<Stats::HEALTH>() < 0 || block.get<Stats::HEALTH>() > block.getMaximum<Stats::HEALTH>()) {
+                fail("health of " + name + " out of range");
+            }
+            if (block.get<Stats::ENERGY>() < 0 || block.get<Stats::ENERGY>() > block.getMaximum<Stats::ENERGY>()) {
+                fail("energy of " + name + " out of range");
+            }
+            if (!entities.inventory[entity].consistent()) {
+                fail("inventory of " + name + " inconsistent");
+            }
+        }
+        if (!player) {
+            return;
+        }
+        if (currentLocation < 0 || currentLocation >= static_cast<int>(locations.size())) {
+            fail("current location out of range");
+        }
+        if (!visited[currentLocation] || explored == 0 || explored > locations.size() ||
+            explored != static_cast<uint32_t>(std::count(visited.begin(), visited.end(), true))) {
+            fail("locations explored miscounted");
+        }
+        if (!locations.consistent(player->getInventory())) {
+            fail("an item is in two places at once");
+        }
+        if (player->getInventory().size() != static_cast<size_t>(player->getItemsCollected())) {
+            fail("items collected and carried differ");
+        }
+        for (const auto& quest : quests) {
+            if (!quest.consistent(player->getQuestFlags())) {
+                fail("quest " + quest.getName() + " out of step with its objectives");
+            }
+        }
+        if (!fight && !alive(player->getEntity()) && !gameOver) {
+            fail("the player is down but the game goes on");
+        }
+    }
+
+    // Whether the world clock has anything left to do in this session
+    bool active() const {
+        bool playing = stage != Stage::NAME && stage != Stage::FINISHED && !gameOver;
+        return playing && (!recovering.empty() || !walking.empty() ||
+                           nextTimer < world->script.timerTriggers().size());
+    }
+
+    // Advances the world clock by count ticks: entities regenerate, patrols
+    // walk on and timers that have come due go off, outside of any turn.
+    // A fight holds the clock for the stats and the enemy in it. Whatever
+    // this prints is presented at once.
+    void tick(uint64_t count) {
+        if (count == 0 || !active()) {
+            return;
+        }
+        Span span(*this, Telemetry::TICK);
+        if (journal) {
+            journal->tick(count);
+        }
+        uint64_t from = clock;
+        clock += count;
+        bool shown = false;
+        for (size_t i = 0; i < recovering.size();) {
+            StatBlock& stats = entities.stats[recovering[i]];
+            if (fight || (alive(recovering[i]) && stats.regenerate(from, clock))) {
+                ++i;
+                continue;
+            }
+            recovering[i] = recovering.back();
+            recovering.pop_back();
+        }
+        for (size_t i = 0; i < walking.size();) {
+            EntityId enemy = enemies[world->patrols[walking[i]].enemy];
+            if (!alive(enemy)) {
+                walking[i] = walking.back();
+                walking.pop_back();
+                continue;
+            }
+            if (!fight || fight->enemy != enemy) {
+                shown = walk(walking[i], count) || shown;
+            }
+            ++i;
+        }
+        const auto& timers = world->script.timerTriggers();
+        while (!fight && nextTimer < timers.size() && timers[nextTimer].first <= clock) {
+            const TriggerProgram::Trigger& trigger = world->script.trigger(timers[nextTimer++].second);
+            if (!applies(trigger)) {
+                continue;
+            }
+            for (uint32_t pc = trigger.actions; pc < trigger.end; ++pc) {
+                execute(world->script.at(pc));
+            }
+            shown = true;
+        }
+        if (shown) {
+            present();
+        }
+    }
+
+private:
+    // Creates the player once the name is known, restoring a save if one
+    // is being resumed
+    void begin(const std::string& playerName, const std::vector<SaveFormat::Section>& saved) {
+        if (playerName.empty()) {
+            throw std::invalid_argument("Name cannot be empty!");
+        }
+
+        player = arena.make<Player>(entities, entities.createPlayer(playerName));
+        initializeQuests();
+        initializeEnemies();
+        visited.assign(locations.size(), false);
+        restore(saved);
+        visit(currentLocation);
+        wakeAll();
+        if (station) {
+            station->enter(static_cast<uint32_t>(currentLocation), occupant, playerName);
+        }
+        stage = Stage::OPENING;
+    }
+
+    void acceptName() {
+        begin(readLine(), {});
+    }
+
+    // Runs the current stage. Returns false when it has to wait for input
+    // or the session is over.
+    bool advance() {
+        switch (stage) {
+            case Stage::OPENING:
+                Telemetry::count(Telemetry::SESSIONS);
+                displayTitle();
+                typewriter(Text::OPENING, player->getName());
+                typewriter(Text::WELCOME);
+                stage = Stage::TURN;
+                return true;
+
+            case Stage::TURN:
+                if (gameOver || hasEscaped) {
+                    stage = Stage::FINISHED;
+                    return false;
+                }
+                if (!savePath.empty()) {
+                    checkpoint();
+                }
+                displayLocation();
+
+                Text::print(out, Text::MENU);
+                Text::print(out, Text::MENU_PROMPT);
+                stage = Stage::MENU_CHOICE;
+                return true;
+
+            case Stage::MENU_CHOICE: {
+                if (!choiceReady()) {
+                    return false;
+                }
+                int choice;
+                if (!readChoice(choice)) {
+                    stage = Stage::FINISHED;
+                    return false;
+                }
+                // Timed up to the "Press Enter" pause
+                turnSpan.emplace(*this, turnMetric(choice));
+                chooseAction(choice);
+                return true;
+            }
+
+            case Stage::MOVE_CHOICE: {
+                if (!choiceReady()) {
+                    return false;
+                }
+                int loc;
+                if (readChoice(loc) && loc >= 1 && loc <= static_cast<int>(locations.size())) {
+                    travelTo(loc - 1);
+                }
+                endTurn();
+                return true;
+            }
+
+            case Stage::INTERACT_CHOICE: {
+                if (!choiceReady()) {
+                    return false;
+                }
+                const auto& availableInteractions = locations[currentLocation].getAvailableInteractions();
+                int interactionChoice;
+                if (readChoice(interactionChoice) &&
+                    interactionChoice >= 1 && interactionChoice <= static_cast<int>(availableInteractions.size())) {
+                    InteractionId action = locations[currentLocation].getInteractionKey(interactionChoice - 1);
+                    typewriter(locations[currentLocation].interact(action, player, *text));
+                    fireTriggers(TriggerEvent::INTERACT, action);
+                    stage = Stage::INTERACT_TRIGGERS;
+                } else {
+                    endTurn();
+                }
+                return true;
+            }
+
+            case Stage::PICKUP_CHOICE: {
+                if (!choiceReady()) {
+                    return false;
+                }
+                int choice;
+                if (readChoice(choice) && pickUp(choice)) {
+                    stage = Stage::PICKUP_TRIGGERS;
+                } else {
+                    pickupSpan.reset();
+                    endTurn();
+                }
+                return true;
+            }
+
+            case Stage::INTERACT_TRIGGERS:
+                if (!runTriggers()) {
+                    return false;
+                }
+                endTurn();
+                return true;
+
+            case Stage::PICKUP_TRIGGERS:
+                if (!runTriggers()) {
+                    return false;
+                }
+                player->gainExperience(5, out);
+                pickupSpan.reset();
+                endTurn();
+                return true;
+
+            case Stage::TURN_TRIGGERS:
+                if (!runTriggers()) {
+                    return false;
+                }
+                turnSpan.reset();
+
+                if (!gameOver && !headless) {
+                    Text::print(out, Text::PRESS_ENTER);
+                    stage = Stage::PAUSE;
+                } else {
+                    stage = Stage::TURN_END;
+                }
+                return true;
+
+            case Stage::PAUSE:
+                if (!characterReady()) {
+                    return false;
+                }
+                if (!readCharacter()) {
+                    gameOver = true;
+                }
+                out << AnsiArt::CLEAR_SCREEN;
+                stage = Stage::TURN_END;
+                return true;
+
+            case Stage::TURN_END:
+                if (hasEscaped) {
+                    Telemetry::count(Telemetry::ESCAPES);
+                    out << AnsiArt::GREEN;
+                    Text::print(out, Text::VICTORY);
+                    out << AnsiArt::RESET << '\n';
+                    displayEndGameStats();
+                }
+                stage = Stage::TURN;
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    // Acts on a choice from the main menu; options that ask a follow-up
+    // question leave the turn waiting for the answer
+    void chooseAction(int choice) {
+        switch (choice) {
+            case 1: {
+                Text::line(out, Text::AVAILABLE_LOCATIONS);
+                for (size_t i = 0; i < locations.size(); ++i) {
+                    Text::line(out, Text::NUMBERED_ENTRY, i + 1, world->locations[i].name);
+                }
+                Text::print(out, Text::LOCATION_PROMPT, locations.size());
+                stage = Stage::MOVE_CHOICE;
+                return;
+            }
+            case 2: {
+                const auto& availableInteractions = locations[currentLocation].getAvailableInteractions();
+                Text::line(out, Text::AVAILABLE_INTERACTIONS);
+                for (size_t i = 0; i < availableInteractions.size(); ++i) {
+                    Text::line(out, Text::NUMBERED_ENTRY, i + 1, availableInteractions[i]);
+                }
+
+                if (!availableInteractions.empty()) {
+                    Text::print(out, Text::INTERACTION_PROMPT);
+                    stage = Stage::INTERACT_CHOICE;
+                    return;
+                }
+                Text::line(out, Text::NO_INTERACTIONS);
+                break;
+            }
+            case 3:
+                if (offerPickup()) {
+                    stage = Stage::PICKUP_CHOICE;
+                    return;
+                }
+                break;
+            case 4:
+                player->display(out);
+                break;
+            case 5: {
+                auto yesNo = [this](FlagId flag) { return (*text)[player->hasQuestFlag(flag) ? Text::YES : Text::NO]; };
+                Text::line(out, Text::STATUS_REPORT);
+                Text::line(out, Text::STATUS_TERMINAL, yesNo(Names::TERMINAL_HACKED));
+                Text::line(out, Text::STATUS_SECURITY, yesNo(Names::SECURITY_DEFEATED));
+                Text::line(out, Text::STATUS_ESCAPED, yesNo(Names::AIRLOCK_ESCAPED));
+                break;
+            }
+            case 6:
+
+                gameOver = true;
+                displayendTitle();
+                break;
+            default:
+                Text::line(out, Text::INVALID_CHOICE);
+        }
+        endTurn();
+    }
 
-    void runDatapadEffect() {
-        std::cout << "You carefully read through the classified information..." << std::endl;
-        std::cout << "The data reveals coordinates for a potentially habitable planet beyond Pluto." << std::endl;
-        std::cout << "This could be humanity's best chance for survival!" << std::endl;
-        player->setQuestFlag("read_classified_info");
-        player->gainExperience(20);
-    }
-    void runEMPEffect() {
-        if (player->hasItem("EMP Device")) {
-            std::cout << "EMP deployed successfully!" << std::endl;
-            // EMP does extra damage to robots
-            return;
+    // Story beats that follow from where the player stands
+    void endTurn() {
+        fireTriggers(TriggerEvent::TURN, 0);
+        stage = Stage::TURN_TRIGGERS;
+    }
+
+    // Lists the items here; false if there is nothing to choose from
+    bool offerPickup() {
+        pickupSpan.emplace(*this, Telemetry::PICKUP);
+        const Inventory& items = locations[currentLocation].getItems();
+        if (items.empty()) {
+            Text::line(out, Text::NO_ITEMS);
+            pickupSpan.reset();
+            return false;
+        }
+
+        Text::line(out, Text::AVAILABLE_ITEMS);
+        offered.clear();
+        for (size_t i = 0; i < items.size(); ++i) {
+            offered.emplace_back(items[i], items.handleAt(i));
+            if (items[i]->canPickup()) {
+                Text::line(out, Text::NUMBERED_ITEM, i + 1, items[i]->getName(), items[i]->getDescription());
+            }
         }
-        std::cout << "You don't have an EMP device to use." << std::endl;
+
+        Text::print(out, Text::PICKUP_PROMPT, items.size());
+        return true;
     }
 
-    bool checkWinCondition() {
-        return player->hasQuestFlag("read_classified_info") && 
-               player->hasQuestFlag("terminal_hacked") &&
-               player->hasQuestFlag("security_defeated") && 
-               player->hasQuestFlag("spacesuit_equipped");
+    // Returns whether an item was picked up; using it fires its triggers
+    bool pickUp(int choice) {
+        if (choice <= 0 || choice > static_cast<int>(offered.size())) {
+            return false;
+        }
+        auto [item, handle] = offered[choice - 1];
+        if (!item->canPickup()) {
+            Text::line(out, Text::NOT_AVAILABLE);
+            return false;
+        }
+        if (!locations.take(currentLocation, handle, item)) {
+            Text::line(out, Text::TAKEN_FIRST, item->getName());
+            return false;
+        }
+        player->addItem(item);
+        player->incrementItemsCollected();
+        Telemetry::count(Telemetry::ITEMS_COLLECTED);
+        Text::line(out, Text::PICKED_UP, item->getName());
+
+        if (item->canUse()) {
+            Text::line(out, Text::USING_ITEM, item->getName());
+            fireTriggers(TriggerEvent::USE, item->getId());
+        }
+        return true;
     }
+};
 
-    void interact(const std::string& key) {
-        auto it = locations[currentLocation].interactions.find(key);
-        if (it != locations[currentLocation].interactions.end()) {
-            if (key == "hack terminal" && !player->hasItem("Keycard")) {
-                std::cout << "The terminal is locked. You need a keycard to access it." << std::endl;
-                return;
+// Fixed pool of worker threads that runs queued game sessions
+class SessionPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable allDone;
+    size_t pending;
+    bool stopping;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop();
             }
-            typewriterEffect(it->second);
-        } else {
-            std::cout << "Nothing interesting happens." << std::endl;
+            job();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                allDone.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit SessionPool(size_t threadCount) : pending(0), stopping(false) {
+        for (size_t i = 0; i < std::max<size_t>(1, threadCount); ++i) {
+            workers.emplace_back(&SessionPool::workerLoop, this);
         }
     }
 
-    void handleCombat(std::shared_ptr<CombatEntity> enemy) {
-        std::cout << "\nCombat with " << enemy->getName() << " initiated!" << std::endl;
+    ~SessionPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
 
-        auto playerCombat = std::make_shared<CombatPlayer>(player->getName());
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
 
-        while (enemy->isAlive() && playerCombat->isAlive()) {
-            // Player turn
-            std::cout << "\n1. Attack\n2. Use EMP (if available)\n";
-            int choice;
-            std::cin >> choice;
-            std::cin.ignore();
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push(std::move(job));
+            ++pending;
+        }
+        jobReady.notify_one();
+    }
 
-            int playerDamage = 0;
-            if (choice == 2 && player->hasItem("EMP Device")) {
-                // EMP does extra damage to robots
-                playerDamage = playerCombat->calculateDamage() * 2;
-                std::cout << "EMP deployed successfully!" << std::endl;
+    // Blocks until every submitted session has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+
+    size_t size() const { return workers.size(); }
+};
+
+// Runs a batch of small jobs, job(0) .. job(count - 1), on a fixed set of
+// threads that includes the caller. The batch is dealt out in blocks, one
+// deque of blocks per thread. A thread works through its own deque from
+// the back and, once that is empty, steals blocks from the front of the
+// others', so uneven jobs even out without a shared queue to contend on.
+class WorkStealingPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        // [first, last) job indices per block
+        std::deque<std::pair<size_t, size_t>> blocks;
+    };
+
+    // Queue 0 belongs to the caller of run()
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    // Set before the blocks of its batch are dealt, so whoever takes a
+    // block sees the job it belongs to
+    const std::function<void(size_t)>* job;
+    uint64_t batch;
+    // Workers inside the current batch
+    size_t busy;
+    std::atomic<size_t> remaining;
+    bool stopping;
+
+    bool take(size_t self, std::pair<size_t, size_t>& block) {
+        {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.blocks.empty()) {
+                block = own.blocks.back();
+                own.blocks.pop_back();
+                return true;
             }
-            else if (choice == 1 ) {
-                std::cout << "You do a Normal Attack" << std::endl;
-                playerDamage = playerCombat->calculateDamage();
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.blocks.empty()) {
+                block = victim.blocks.front();
+                victim.blocks.pop_front();
+                return true;
             }
-            else {
-                std::cout << "You do not have an EMP! \n You do a Normal Attack" << std::endl;
-                playerDamage = playerCombat->calculateDamage();
+        }
+        return false;
+    }
+
+    void work(size_t self) {
+        std::pair<size_t, size_t> block;
+        while (take(self, block)) {
+            for (size_t i = block.first; i < block.second; ++i) {
+                (*job)(i);
             }
+            remaining -= block.second - block.first;
+        }
+    }
+
+    void workerLoop(size_t self) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                started.wait(lock, [this, seen] { return stopping || batch != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = batch;
+                ++busy;
+            }
+            work(self);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) {
+                finished.notify_all();
+            }
+        }
+    }
 
-            enemy->takeDamage(playerDamage);
-            typewriterEffect("You deal " + std::to_string(playerDamage) + " damage!");
+public:
+    explicit WorkStealingPool(size_t threadCount)
+        : job(nullptr), batch(0), busy(0), remaining(0), stopping(false) {
+        size_t count = std::max<size_t>(1, threadCount);
+        for (size_t i = 0; i < count; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 1; i < count; ++i) {
+            workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        started.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
 
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
 
-            if (!enemy->isAlive()) {
-                typewriterEffect("You defeated " + enemy->getName() + "!");
-                player->setQuestFlag("security_defeated");
-                player->gainExperience(50);
-                player->display();
+    // Runs job(i) for every i below count and returns once all have run.
+    // Jobs of one batch run concurrently and must not touch the same state.
+    void run(size_t count, const std::function<void(size_t)>& batchJob) {
+        if (count == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &batchJob;
+        }
+        remaining = count;
+        // A few blocks per thread, so there is something left to steal
+        size_t blockSize = std::max<size_t>(1, count / (queues.size() * 4));
+        size_t owner = 0;
+        for (size_t first = 0; first < count; first += blockSize) {
+            Queue& queue = *queues[owner];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.blocks.emplace_back(first, std::min(count, first + blockSize));
+            owner = (owner + 1) % queues.size();
+        }
+        if (count > blockSize) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++batch;
             }
+            started.notify_all();
+        }
+        work(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return remaining == 0 && busy == 0; });
+    }
 
-                // Enemy turn
-            if (choice != 2 && !player->hasItem("EMP")) {
-                int enemyDamage = enemy->calculateDamage();
-                playerCombat->takeDamage(enemyDamage);
-                typewriterEffect(enemy->getName() + " deals " + std::to_string(enemyDamage) + " damage!");
+    size_t size() const { return queues.size(); }
+};
 
+// Runs the same command script as many independent headless sessions.
+// Every session gets its own input and output streams and its own Game;
+// only the static WorldData is shared.
+// With a base seed, session i uses seed + i so the whole batch is reproducible,
+// and with a save path session i checkpoints to <savePath>.<i>. With a
+// shared station every session plays in it, racing the others for its items.
+int runSessions(const std::string& script, size_t sessionCount, size_t threadCount,
+                std::optional<uint64_t> seed, std::shared_ptr<const WorldData> world,
+                const std::string& savePath = "", Journal* journal = nullptr,
+                SharedStation* station = nullptr) {
+    std::atomic<size_t> failed(0);
+    auto start = std::chrono::steady_clock::now();
+    {
+        SessionPool pool(threadCount);
+        for (size_t i = 0; i < sessionCount; ++i) {
+            pool.submit([&script, &world, &failed, &savePath, journal, station, seed, i] {
+                std::istringstream input(script);
+                std::unique_ptr<SessionJournal> recorder;
+                std::istream journaled(nullptr);
+                NullStream output;
+                GameOptions options;
+                options.headless = true;
+                options.station = station;
+                if (seed) {
+                    options.seed = *seed + i;
+                }
+                if (!savePath.empty()) {
+                    options.savePath = savePath + "." + std::to_string(i);
+                }
+                if (journal) {
+                    recorder = std::make_unique<SessionJournal>(*journal, input.rdbuf());
+                    journaled.rdbuf(recorder.get());
+                    options.journal = recorder.get();
+                }
+                try {
+                    Game game(journal ? journaled : input, output, options, world);
+                    game.run();
+                } catch (const std::exception&) {
+                    failed++;
+                }
+            });
+        }
+        pool.wait();
+        threadCount = pool.size();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::cout << "Ran " << sessionCount << " sessions on " << threadCount << " threads in "
+              << elapsed.count() << " ms (" << failed << " failed)" << '\n';
+    if (journal) {
+        // Throws if the last sessions' records did not make it to disk
+        journal->sync();
+        std::cout << "Journal committed in " << journal->commitCount() << " syncs" << '\n';
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+// Replays the sessions of a journal against fresh Games and checks that
+// every fight drew the seed that was recorded. Input and world ticks are
+// replayed in the order they came. With a session ID only that session is
+// replayed, and its output is shown.
+int replayJournal(const std::string& path, std::shared_ptr<const WorldData> world,
+                  std::optional<uint32_t> only) {
+    struct Session {
+        std::optional<Journal::BeginRecord> begin;
+        // INPUT and TICK records, in order
+        std::vector<Journal::Record> events;
+        size_t inputs = 0;
+        std::vector<uint64_t> combatSeeds;
+        bool finished = false;
+    };
+    std::map<uint32_t, Session> sessions;
+    for (const auto& record : Journal::read(path)) {
+        auto& session = sessions[record.session];
+        if (record.kind == Journal::BEGIN && record.payload.size() == sizeof(Journal::BeginRecord)) {
+            Journal::BeginRecord begin;
+            std::memcpy(&begin, record.payload.data(), sizeof(begin));
+            session.begin = begin;
+        } else if (record.kind == Journal::INPUT) {
+            session.events.push_back(record);
+            session.inputs++;
+        } else if (record.kind == Journal::TICK && record.payload.size() == sizeof(uint64_t)) {
+            session.events.push_back(record);
+        } else if (record.kind == Journal::COMBAT_SEED && record.payload.size() == sizeof(uint64_t)) {
+            uint64_t combatSeed;
+            std::memcpy(&combatSeed, record.payload.data(), sizeof(combatSeed));
+            session.combatSeeds.push_back(combatSeed);
+        } else if (record.kind == Journal::END) {
+            session.finished = true;
+        }
+    }
+    if (only && sessions.count(*only) == 0) {
+        throw std::invalid_argument("No session " + std::to_string(*only) + " in " + path);
+    }
+
+    size_t diverged = 0;
+    for (const auto& [id, session] : sessions) {
+        if (only && id != *only) {
+            continue;
+        }
+        std::string outcome;
+        if (!session.begin) {
+            outcome = "has no BEGIN record";
+            diverged++;
+        } else if (session.begin->shared && !only) {
+            // What it found in the rooms depended on everyone else
+            outcome = "played in a shared station, not replayed";
+        } else {
+            // Same seed and the same input, including "Press Enter" lines
+            // when the session was not headless
+            NullStream quiet;
+            GameOptions options;
+            options.headless = session.begin->headless != 0;
+            options.seed = session.begin->seed;
+            try {
+                Game game(only ? static_cast<std::ostream&>(std::cout) : quiet, options, world);
+                for (const auto& event : session.events) {
+                    if (event.kind == Journal::INPUT) {
+                        game.feed(event.payload);
+                        game.step();
+                    } else {
+                        uint64_t ticks;
+                        std::memcpy(&ticks, event.payload.data(), sizeof(ticks));
+                        game.tick(ticks);
+                    }
+                }
+                game.endInput();
+                game.step();
+                bool exact = game.getCombatSeeds() == session.combatSeeds;
+                outcome = exact ? "replayed exactly" : "diverged from its recorded fights";
+                diverged += exact ? 0 : 1;
+            } catch (const std::exception& e) {
+                outcome = std::string("failed: ") + e.what();
+                diverged++;
             }
-            std::cout << "\nYour Health: " << playerCombat->getHealth() << std::endl;
-            std::cout << enemy->getName() << "'s Health: " << enemy->getHealth() << std::endl;
         }
+        std::cout << "Session " << id << ": " << session.inputs << " inputs, " << session.combatSeeds.size()
+                  << " fights" << (session.finished ? "" : ", unfinished") << ", " << outcome << '\n';
     }
+    return diverged == 0 ? 0 : 1;
+}
 
+// Network front end for many players at once. One epoll loop accepts telnet
+// (or plain TCP) clients, does all of their socket I/O without blocking and
+// plays every connection's Game on the same thread: the lines a client sends
+// are fed to its session, which steps as far as they allow and then waits,
+// holding no thread, until more arrive. Whatever a session presents is
+// queued as a whole frame, and the loop sends all the frames queued for a
+// client with one scatter/gather write.
+// A timer ticks the world clock of every session at a fixed rate. Only the
+// sessions whose clock has something to do are ticked, in parallel on a
+// work-stealing pool while the loop waits.
+class Gateway {
 public:
-    // Default constructor with initialization list demonstrating exception handling
-    Game() : gameOver(false), currentLocation(0), hasEscaped(false) {
-        try {
-            displayTitle();
-            std::cout << "\nEnter your name: ";
-            std::string playerName;
-            std::getline(std::cin, playerName);
+    struct Options {
+        // 0 picks any free port
+        uint16_t port = 4000;
+        // Clients beyond this are turned away
+        size_t maxConnections = 16384;
+        // Output queued for a client that has stopped reading before it is dropped
+        size_t maxPendingBytes = 1 << 20;
+        // A longer input line drops the client
+        size_t maxLineBytes = 4096;
+        // World ticks per second; 0 stops the world clock
+        uint32_t tickRate = 10;
+        // Threads ticking sessions, the loop's own included
+        size_t tickThreads = std::thread::hardware_concurrency();
+        // For every session; with a seed, connection i uses seed + i
+        GameOptions game;
+    };
 
-            if (playerName.empty()) {
-                throw std::invalid_argument("Name cannot be empty!");
+private:
+    // A session's output. Composes a frame with telnet's CR LF line ends and
+    // queues it for the loop to send when the game presents it.
+    class Outbox : public std::streambuf {
+    private:
+        std::string frame;
+
+        void put(char ch) {
+            if (ch == '\n') {
+                frame.push_back('\r');
             }
+            frame.push_back(ch);
+        }
 
-            player = std::make_unique<Player>(playerName);
-            initializeLocations();
-            initializeQuests();
-            initializeEnemies();
+    protected:
+        int_type overflow(int_type ch) override {
+            if (ch != traits_type::eof()) {
+                put(traits_type::to_char_type(ch));
+            }
+            return traits_type::not_eof(ch);
+        }
 
-        } catch (const std::exception& e) {
-            std::cerr << "Error during game initialization: " << e.what() << std::endl;
-            throw;
+        std::streamsize xsputn(const char* text, std::streamsize count) override {
+            for (std::streamsize i = 0; i < count; ++i) {
+                put(text[i]);
+            }
+            return count;
         }
-    }
 
-    void displayLocation() {
-        std::cout << AnsiArt::BLUE << "\nLocation: " << locations[currentLocation].getName() 
-                  << AnsiArt::RESET << std::endl;
-        std::cout << locations[currentLocation].getDescription() << std::endl;
+        int sync() override {
+            if (!frame.empty()) {
+                pendingBytes += frame.size();
+                frames.push_back(std::move(frame));
+                frame.clear();
+            }
+            return 0;
+        }
 
-        // Display available items
-        auto items = locations[currentLocation].getItems();
-        if (!items.empty()) {
-            std::cout << "\nYou see:" << std::endl;
-            for (const auto& item : items) {
-                std::cout << "- " << item->getName() << ": " << item->getDescription() << std::endl;
+    public:
+        // Presented frames not yet sent; the first may be partly sent
+        std::deque<std::string> frames;
+        size_t sentBytes = 0;
+        size_t pendingBytes = 0;
+    };
+
+    struct Connection {
+        int fd;
+        std::string partial;
+        uint8_t telnet = 0;
+        bool reading = true;
+        bool writeWatched = false;
+        // Our side is shut down; waiting for the client to close its side
+        bool finishing = false;
+        Outbox outbox;
+        std::ostream output;
+        std::unique_ptr<SessionJournal> recorder;
+        // Null once the session is over
+        std::unique_ptr<Game> game;
+        // Position in the ticking list, if the session is in it
+        size_t tickSlot = NOT_TICKING;
+
+        explicit Connection(int socket) : fd(socket), output(&outbox) {}
+    };
+
+    static constexpr size_t NOT_TICKING = static_cast<size_t>(-1);
+
+    // Telnet parser states; negotiation is skipped, not answered
+    enum : uint8_t { DATA, COMMAND, OPTION, SUBNEGOTIATION, SUBNEGOTIATION_COMMAND };
+    static constexpr unsigned char IAC = 255, SB = 250, SE = 240, WILL = 251, DONT = 254;
+
+    Options options;
+    std::shared_ptr<const WorldData> world;
+    Journal* journal;
+    int listener;
+    int epoll;
+    // The signal handler wakes the loop through this
+    int wakeup;
+    // Expires tickRate times a second; -1 without a world clock
+    int ticker;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    // Sessions whose world clock has something to do
+    std::vector<Connection*> ticking;
+    WorkStealingPool tickPool;
+    uint64_t accepted;
+
+    static inline std::atomic<bool> stopRequested{false};
+    static inline std::atomic<int> stopFd{-1};
+
+    static void requestStop(int) {
+        int saved = errno;
+        stopRequested = true;
+        uint64_t one = 1;
+        if (::write(stopFd, &one, sizeof(one)) < 0) {
+            // The loop is already awake
+        }
+        errno = saved;
+    }
+
+    [[noreturn]] void fail(const std::string& what) {
+        std::string message = what + ": " + std::strerror(errno);
+        for (int fd : {listener, epoll, wakeup, ticker}) {
+            if (fd >= 0) {
+                ::close(fd);
             }
         }
+        throw std::runtime_error(message);
+    }
 
-        // Display available interactions
-        std::cout << "\nPossible interactions:" << std::endl;
-        for (const auto& interaction : locations[currentLocation].getAvailableInteractions()) {
-            std::cout << "- " << interaction << std::endl;
+    void watch(int fd, uint32_t events, int operation = EPOLL_CTL_ADD) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll, operation, fd, &event) < 0) {
+            throw std::runtime_error(std::string("epoll_ctl: ") + std::strerror(errno));
         }
     }
 
-    void displayEndGameStats() {
-        std::cout << AnsiArt::YELLOW << "\n=== Final Statistics ===" << AnsiArt::RESET << std::endl;
-        player->display();
+    void updateInterest(Connection& connection) {
+        watch(connection.fd, (connection.reading ? EPOLLIN : 0u) | (connection.writeWatched ? EPOLLOUT : 0u),
+              EPOLL_CTL_MOD);
+    }
 
-        std::cout << "Locations explored: " << currentLocation + 1 << "/" << locations.size() << std::endl;
+    // Lets the session play as far as its input allows, then sends what it
+    // presented
+    void play(Connection& connection) {
+        if (connection.game) {
+            bool playing = false;
+            try {
+                playing = connection.game->step();
+            } catch (const std::exception& e) {
+                connection.output << AnsiArt::RED << "Error: " << e.what() << AnsiArt::RESET << '\n';
+            }
+            if (!playing) {
+                connection.game.reset();
+            }
+        }
+        setTicking(connection, ticker >= 0 && connection.game && connection.game->active());
+        connection.output.flush();
+        flush(connection);
+    }
 
+    void setTicking(Connection& connection, bool active) {
+        if (active && connection.tickSlot == NOT_TICKING) {
+            connection.tickSlot = ticking.size();
+            ticking.push_back(&connection);
+        } else if (!active && connection.tickSlot != NOT_TICKING) {
+            ticking.back()->tickSlot = connection.tickSlot;
+            ticking[connection.tickSlot] = ticking.back();
+            ticking.pop_back();
+            connection.tickSlot = NOT_TICKING;
+        }
     }
 
-    void pickupItem() {
-        auto items = locations[currentLocation].getItems();
-        if (items.empty()) {
-            std::cout << "There are no items to pick up here." << std::endl;
+    // Advances the clock of every active session by the ticks that have
+    // expired, then sends what they printed. Sessions with nothing left to
+    // do drop out until a later step needs the clock again.
+    void tickSessions() {
+        uint64_t expired = 0;
+        if (::read(ticker, &expired, sizeof(expired)) != sizeof(expired) || ticking.empty()) {
             return;
         }
-
-        std::cout << "\nAvailable items to pick up:" << std::endl;
-        for (size_t i = 0; i < items.size(); ++i) {
-            if (items[i]->canPickup()) {
-                std::cout << i + 1 << ". " << items[i]->getName() << ": " << items[i]->getDescription() << std::endl;
+        // Each job touches only its own session
+        std::vector<Connection*> batch = ticking;
+        std::vector<uint8_t> failed(batch.size(), 0);
+        tickPool.run(batch.size(), [&batch, &failed, expired](size_t i) {
+            try {
+                batch[i]->game->tick(expired);
+            } catch (const std::exception& e) {
+                batch[i]->output << AnsiArt::RED << "Error: " << e.what() << AnsiArt::RESET << '\n';
+                batch[i]->game->endInput();
+                failed[i] = 1;
+            }
+        });
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Connection& connection = *batch[i];
+            if (failed[i]) {
+                // Winds the session down
+                play(connection);
+                continue;
             }
+            setTicking(connection, connection.game->active());
+            connection.output.flush();
+            flush(connection);
         }
+    }
 
-        std::cout << "Choose item to pick up (1-" << items.size() << ") or 0 to cancel: ";
-        int choice;
-        std::cin >> choice;
-        std::cin.ignore();
+    void acceptClients() {
+        while (true) {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    std::cerr << "accept: " << std::strerror(errno) << std::endl;
+                }
+                return;
+            }
+            if (connections.size() >= options.maxConnections) {
+                static const char full[] = "The station is full. Try again later.\r\n";
+                if (::send(fd, full, sizeof(full) - 1, MSG_NOSIGNAL) < 0) {
+                    // Turned away either way
+                }
+                ::close(fd);
+                continue;
+            }
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            auto& connection = *connections.emplace(fd, std::make_unique<Connection>(fd)).first->second;
+            watch(fd, EPOLLIN);
+
+            GameOptions game = options.game;
+            if (game.seed) {
+                game.seed = *game.seed + accepted;
+            }
+            accepted++;
+            if (journal) {
+                connection.recorder = std::make_unique<SessionJournal>(*journal, nullptr);
+                game.journal = connection.recorder.get();
+            }
+            try {
+                connection.game = std::make_unique<Game>(connection.output, game, world);
+            } catch (const std::exception& e) {
+                connection.output << AnsiArt::RED << "Error: " << e.what() << AnsiArt::RESET << '\n';
+            }
+            play(connection);
+        }
+    }
 
+    // Splits received bytes into lines, dropping CRs and telnet commands.
+    // Returns false when a line grows past the limit.
+    bool parse(Connection& connection, const char* data, size_t size, std::vector<std::string>& lines) {
+        for (size_t i = 0; i < size; ++i) {
+            unsigned char byte = static_cast<unsigned char>(data[i]);
+            switch (connection.telnet) {
+                case DATA:
+                    if (byte == IAC) {
+                        connection.telnet = COMMAND;
+                    } else if (byte == '\n') {
+                        connection.partial.push_back('\n');
+                        lines.push_back(std::move(connection.partial));
+                        connection.partial.clear();
+                    } else if (byte != '\r' && byte != '\0') {
+                        if (connection.partial.size() >= options.maxLineBytes) {
+                            return false;
+                        }
+                        connection.partial.push_back(static_cast<char>(byte));
+                    }
+                    break;
+                case COMMAND:
+                    if (byte == IAC) {
+                        connection.partial.push_back(static_cast<char>(byte));
+                        connection.telnet = DATA;
+                    } else if (byte == SB) {
+                        connection.telnet = SUBNEGOTIATION;
+                    } else {
+                        connection.telnet = byte >= WILL && byte <= DONT ? OPTION : DATA;
+                    }
+                    break;
+                case OPTION:
+                    connection.telnet = DATA;
+                    break;
+                case SUBNEGOTIATION:
+                    if (byte == IAC) {
+                        connection.telnet = SUBNEGOTIATION_COMMAND;
+                    }
+                    break;
+                default:
+                    connection.telnet = byte == SE ? DATA : SUBNEGOTIATION;
+                    break;
+            }
+        }
+        return true;
+    }
 
-    if (choice > 0 && choice <= static_cast<int>(items.size())) {
-        auto item = items[choice - 1];
-        if (item->canPickup()) {
-            player->addItem(item);
-            locations[currentLocation].removeItem(item->getName());
-            player->incrementItemsCollected();
-            std::cout << "Picked up " << item->getName() << std::endl;
-            
-            if (item->canUse()) {
-                std::cout << "\nUsing Item " << item->getName() << "..." << std::endl;
-                item->use();
+    void receive(Connection& connection) {
+        if (!connection.reading) {
+            // Hung up in both directions after its input already ended
+            closeSocket(connection);
+            return;
+        }
+        char buffer[4096];
+        std::vector<std::string> lines;
+        bool closed = false;
+        while (true) {
+            ssize_t count = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (count > 0) {
+                if (!connection.finishing && !parse(connection, buffer, static_cast<size_t>(count), lines)) {
+                    closeSocket(connection);
+                    return;
+                }
+                continue;
+            }
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (count < 0 || connection.finishing) {
+                closeSocket(connection);
+                return;
+            }
+            closed = true;
+            break;
+        }
+        if (connection.game) {
+            for (const auto& line : lines) {
+                if (connection.recorder) {
+                    connection.recorder->input(line);
                 }
+                connection.game->feed(line);
+            }
+            if (closed) {
+                connection.game->endInput();
+            }
+        }
+        if (closed) {
+            // The client may still be reading what the session has to say
+            connection.reading = false;
+            updateInterest(connection);
+        }
+        play(connection);
+    }
 
+    // Sends as much queued output as the socket takes without blocking
+    void flush(Connection& connection) {
+        Outbox& queue = connection.outbox;
+        if (queue.pendingBytes > options.maxPendingBytes) {
+            closeSocket(connection);
+            return;
+        }
+        while (!queue.frames.empty()) {
+            iovec chunks[64];
+            size_t count = 0;
+            for (auto& frame : queue.frames) {
+                if (count == std::size(chunks)) {
+                    break;
+                }
+                size_t skip = count == 0 ? queue.sentBytes : 0;
+                chunks[count++] = iovec{&frame[skip], frame.size() - skip};
+            }
+            msghdr message{};
+            message.msg_iov = chunks;
+            message.msg_iovlen = count;
+            ssize_t sent = ::sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                closeSocket(connection);
+                return;
+            }
+            queue.pendingBytes -= static_cast<size_t>(sent);
+            size_t done = queue.sentBytes + static_cast<size_t>(sent);
+            while (!queue.frames.empty() && done >= queue.frames.front().size()) {
+                done -= queue.frames.front().size();
+                queue.frames.pop_front();
+            }
+            queue.sentBytes = done;
+        }
 
-            player->gainExperience(5);
-        } else {
-            std::cout << "This item is not yet available." << std::endl;
+        bool blocked = !queue.frames.empty();
+        if (blocked != connection.writeWatched) {
+            connection.writeWatched = blocked;
+            updateInterest(connection);
+        }
+        if (!connection.game && !blocked && !connection.finishing) {
+            // Closing with unread input would reset the connection and could
+            // lose the last frame, so shut our side and wait for the client's
+            connection.finishing = true;
+            ::shutdown(connection.fd, SHUT_WR);
+            if (!connection.reading) {
+                closeSocket(connection);
+            }
         }
     }
-}
-    void run() {
-        try {
-            displayTitle();
-            typewriterEffect("You are " + player->getName() + 
-                           ", a maintenance worker on Europa Station.");
-            typewriterEffect("\nWelcome to Space Station Europa. Your mission: Escape and reveal the truth.");
 
-            while (!gameOver && !hasEscaped) {
-                displayLocation();
+    // Ends the session as if its input had run out and forgets the
+    // connection, which the caller must not touch afterwards
+    void closeSocket(Connection& connection) {
+        setTicking(connection, false);
+        if (connection.game) {
+            connection.game->endInput();
+            try {
+                connection.game->step();
+            } catch (const std::exception&) {
+                // Nobody is left to tell
+            }
+        }
+        ::epoll_ctl(epoll, EPOLL_CTL_DEL, connection.fd, nullptr);
+        ::close(connection.fd);
+        connections.erase(connection.fd);
+    }
 
-                std::cout << "\nOptions:\n";
-                std::cout << "1. Move to another location\n";
-                std::cout << "2. Interact with environment\n";
-                std::cout << "3. Pick up item\n";
-                std::cout << "4. Check inventory\n";
-                std::cout << "5. Check status\n";
-                std::cout << "6. Quit\n";
+public:
+    Gateway(const Options& gatewayOptions, std::shared_ptr<const WorldData> worldData, Journal* sessionJournal = nullptr)
+        : options(gatewayOptions), world(std::move(worldData)), journal(sessionJournal),
+          listener(-1), epoll(-1), wakeup(-1), ticker(-1), tickPool(options.tickThreads), accepted(0) {
+        listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listener < 0) {
+            fail("socket");
+        }
+        int one = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(options.port);
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            fail("Cannot listen on port " + std::to_string(options.port));
+        }
+        if (::listen(listener, SOMAXCONN) < 0) {
+            fail("listen");
+        }
+        socklen_t length = sizeof(address);
+        if (::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0) {
+            options.port = ntohs(address.sin_port);
+        }
+        epoll = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll < 0 || wakeup < 0) {
+            fail("epoll");
+        }
+        watch(listener, EPOLLIN);
+        watch(wakeup, EPOLLIN);
+        if (options.tickRate > 0) {
+            ticker = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (ticker < 0) {
+                fail("timerfd");
+            }
+            itimerspec period{};
+            period.it_interval.tv_sec = 1 / options.tickRate;
+            period.it_interval.tv_nsec = 1000000000L / options.tickRate % 1000000000L;
+            period.it_value = period.it_interval;
+            ::timerfd_settime(ticker, 0, &period, nullptr);
+            watch(ticker, EPOLLIN);
+        }
+    }
 
-                int choice;
-                std::cout << "\nEnter your choice (1-8): ";
-                std::cin >> choice;
-                std::cin.ignore();
-
-                switch (choice) {
-                    case 1: {
-                        std::cout << "\nAvailable locations:\n";
-                        for (size_t i = 0; i < locations.size(); ++i) {
-                            std::cout << i + 1 << ". " << locations[i].getName() << std::endl;
-                        }
-                        std::cout << "Choose location (1-" << locations.size() << "): ";
-                        int loc;
-                        std::cin >> loc;
-                        if (loc >= 1 && loc <= static_cast<int>(locations.size())) {
-                            currentLocation = loc - 1;
-                            player->incrementSteps();
-                        }
-                        break;
-                    }
-                    case 2: {
-                        const auto& availableInteractions = locations[currentLocation].getAvailableInteractions();
-                        std::cout << "\nAvailable interactions:" << std::endl;
-                        for (size_t i = 0; i < availableInteractions.size(); ++i) {
-                            std::cout << i + 1 << ". " << availableInteractions[i] << std::endl;
-                        }
+    // Ends the sessions of everyone still playing
+    ~Gateway() {
+        while (!connections.empty()) {
+            closeSocket(*connections.begin()->second);
+        }
+        stopFd = -1;
+        ::close(listener);
+        ::close(epoll);
+        ::close(wakeup);
+        if (ticker >= 0) {
+            ::close(ticker);
+        }
+    }
 
-                        if (!availableInteractions.empty()) {
-                            std::cout << "Choose interaction: ";
-                            int interactionChoice;
-                            std::cin >> interactionChoice;
-                            std::cin.ignore();
-
-                            if (interactionChoice >= 1 && interactionChoice <= static_cast<int>(availableInteractions.size())) {
-                                std::string action = availableInteractions[interactionChoice - 1];
-                                //std::string result = locations[currentLocation].interact(action);
-                                std::string result = locations[currentLocation].interact(action, player.get());
-                                typewriterEffect(result);
-
-                                if (action == "hack terminal") {
-                                    player->setQuestFlag("terminal_hacked");
-                                    handleCombat(enemies[0]);
-                                } else if (action == "activate airlock" && 
-                                         player->hasQuestFlag("terminal_hacked") && 
-                                         player->hasQuestFlag("security_defeated")) {
-                                    player->setQuestFlag("airlock_escaped");
-                                    hasEscaped = true;
-                                    typewriterEffect("Congratulations! You've escaped and can now reveal the truth!");
-                                    gameOver = true;
-                                }
-                            }
-                        } else {
-                            std::cout << "No interactions available here." << std::endl;
+    Gateway(const Gateway&) = delete;
+    Gateway& operator=(const Gateway&) = delete;
+
+    uint16_t port() const { return options.port; }
+
+    // Serves clients until SIGINT or SIGTERM
+    int run() {
+        stopFd = wakeup;
+        struct sigaction stop{};
+        stop.sa_handler = &Gateway::requestStop;
+        ::sigaction(SIGINT, &stop, nullptr);
+        ::sigaction(SIGTERM, &stop, nullptr);
+
+        std::cout << "Listening on port " << options.port << std::endl;
+        std::vector<epoll_event> events(256);
+        while (!stopRequested) {
+            int count = ::epoll_wait(epoll, events.data(), static_cast<int>(events.size()), -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("epoll_wait: ") + std::strerror(errno));
+            }
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listener) {
+                    acceptClients();
+                } else if (fd == wakeup) {
+                    continue;
+                } else if (fd == ticker) {
+                    tickSessions();
+                } else if (auto found = connections.find(fd); found != connections.end()) {
+                    Connection& connection = *found->second;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                        receive(connection);
+                        if (connections.find(fd) == connections.end()) {
+                            continue;
                         }
-                        break;
                     }
-                    case 3:
-                        pickupItem();
-                        break;
-                    case 4:
-                        player->display();
-                        break;
-                    case 5: {
-                        std::cout << "\nStatus Report:" << std::endl;
-                        std::cout << "Terminal Hacked: " << (player->hasQuestFlag("terminal_hacked") ? "Yes" : "No") << std::endl;
-                        std::cout << "Security Defeated: " << (player->hasQuestFlag("security_defeated") ? "Yes" : "No") << std::endl;
-                        std::cout << "Escaped: " << (player->hasQuestFlag("airlock_escaped") ? "Yes" : "No") << std::endl;
-                        break;
+                    if (events[i].events & EPOLLOUT) {
+                        flush(connection);
                     }
-                    case 6:
-
-                        gameOver = true;
-                        displayendTitle();
-                        break;
-                    default:
-                        std::cout << "Invalid choice." << std::endl;
                 }
+            }
+        }
+        std::cout << "Shutting down; " << connections.size() << " players disconnected" << std::endl;
+        return 0;
+    }
+};
 
-
-                // Special interaction handling
-               if (currentLocation == 1 && // Terminal Room
-                    player->hasQuestFlag("terminal_access_granted") &&
-                    !player->hasQuestFlag("security_defeated")) {
-                    std::cout << "\nA Security Bot has detected your presence!" << std::endl;
-                    handleCombat(enemies[0]); // Fight the security bot
+// Tools that reuse the engine (tools/*.cpp) include this file with
+// SPACE_DYSTOPIA_NO_MAIN defined and bring their own main()
+#ifndef SPACE_DYSTOPIA_NO_MAIN
+
+// Usage: game [--script <file>] [--headless] [--quiet] [--seed <n>] [--world <file>]
+//             [--save <file>] [--journal <file>] [--telemetry <file>]
+//             [--sessions <n>] [--threads <n>] [--listen <port>] [--tick-rate <n>] [--shared]
+//             [--text <file>]
+//        game --compile-world <source> <output>
+//        game --compile-text <source> <output>
+//        game --replay <journal> [--replay-session <id>] [--world <file>]
+//   --script   read commands from a file instead of the keyboard
+//   --headless skip typewriter delays and "Press Enter" pauses
+//   --quiet    discard all game output
+//   --seed     RNG seed, to replay a session exactly
+//   --world    load world content from a text source or compiled world file
+//   --save     resume from a save file if it exists and checkpoint to it every turn
+//   --journal  append every session's input and seeds to a journal
+//   --replay   replay a journal's sessions and check they reproduce exactly
+//   --replay-session  replay only this session and show its output
+//   --telemetry  record latency histograms and counters, rewriting a report
+//                file with the totals every second
+//   --compile-world  pack a text world source into a compiled world file
+//   --compile-text   pack a text table source into a compiled text file
+//   --sessions run the script as <n> concurrent headless sessions
+//   --threads  worker threads for --sessions, or ticking --listen sessions
+//              (default: one per core)
+//   --listen   serve a session to every telnet client connecting on <port>
+//   --tick-rate  world clock ticks per second for --listen (default 10, 0 for none)
+//   --shared   put every session of --sessions or --listen in one station
+//   --text     word the game's messages from a text source or compiled text file
+int main(int argc, char* argv[]) {
+    std::string scriptPath;
+    bool quiet = false;
+    GameOptions options;
+    std::string worldPath;
+    std::string textPath;
+    std::string journalPath;
+    std::string telemetryPath;
+    std::string replayPath;
+    std::optional<uint32_t> replaySession;
+    size_t sessionCount = 0;
+    size_t threadCount = std::thread::hardware_concurrency();
+    std::optional<uint16_t> listenPort;
+    uint32_t tickRate = 10;
+    bool shared = false;
+#ifdef SPACE_DYSTOPIA_HEADLESS
+    options.headless = true;
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--script" && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (arg == "--world" && i + 1 < argc) {
+            worldPath = argv[++i];
+        } else if (arg == "--text" && i + 1 < argc) {
+            textPath = argv[++i];
+        } else if (arg == "--save" && i + 1 < argc) {
+            options.savePath = argv[++i];
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (arg == "--telemetry" && i + 1 < argc) {
+            telemetryPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--replay-session" && i + 1 < argc) {
+            replaySession = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--compile-world" && i + 2 < argc) {
+            try {
+                std::ifstream source(argv[i + 1]);
+                if (!source) {
+                    throw std::runtime_error(std::string("Cannot open world source ") + argv[i + 1]);
                 }
-
-                if (currentLocation == 3 && // Airlock
-                    player->hasQuestFlag("security_defeated") &&
-                    player->hasQuestFlag("spacesuit_equipped")) {
-                    hasEscaped = true;
-                    typewriterEffect("Congratulations! You've successfully escaped!");
-                    gameOver = true;
+                std::string image = WorldFormat::compile(source);
+                std::ofstream output(argv[i + 2], std::ios::binary);
+                output.write(image.data(), image.size());
+                if (!output) {
+                    throw std::runtime_error(std::string("Cannot write ") + argv[i + 2]);
                 }
-
-                // Quest progress checking
-                if (player->hasQuestFlag("read_classified_info") &&
-                    player->hasQuestFlag("touched_monolith") &&
-                    player->hasQuestFlag("spacesuit_equipped")) {
-                    quests[0].updateObjective(0, 1); // Update main quest progress
+                return 0;
+            } catch (const std::exception& e) {
+                std::cerr << "Fatal error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--compile-text" && i + 2 < argc) {
+            try {
+                std::ifstream source(argv[i + 1]);
+                if (!source) {
+                    throw std::runtime_error(std::string("Cannot open text source ") + argv[i + 1]);
                 }
-
-                if (!gameOver) {
-                    std::cout << "\nPress Enter to continue...";
-                    std::cin.get();
-                    std::cout << AnsiArt::CLEAR_SCREEN;
+                std::string image = TextFormat::compile(source);
+                std::ofstream output(argv[i + 2], std::ios::binary);
+                output.write(image.data(), image.size());
+                if (!output) {
+                    throw std::runtime_error(std::string("Cannot write ") + argv[i + 2]);
                 }
+                return 0;
+            } catch (const std::exception& e) {
+                std::cerr << "Fatal error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--sessions" && i + 1 < argc) {
+            sessionCount = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threadCount = std::stoul(argv[++i]);
+        } else if (arg == "--listen" && i + 1 < argc) {
+            listenPort = static_cast<uint16_t>(std::stoul(argv[++i]));
+        } else if (arg == "--tick-rate" && i + 1 < argc) {
+            tickRate = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--shared") {
+            shared = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
 
-                if (hasEscaped) {
-                    std::cout << AnsiArt::GREEN << "\nVICTORY!" << AnsiArt::RESET << std::endl;
-                    displayEndGameStats();
-                }
+    try {
+        auto world = worldPath.empty() ? WorldData::builtin() : WorldData::load(worldPath);
+        if (!textPath.empty()) {
+            options.text = TextTable::load(textPath);
+        }
+        if (!replayPath.empty()) {
+            return replayJournal(replayPath, world, replaySession);
+        }
+        std::unique_ptr<Journal> journal;
+        if (!journalPath.empty()) {
+            journal = std::make_unique<Journal>(journalPath);
+        }
+        std::unique_ptr<Telemetry::Exporter> telemetry;
+        if (!telemetryPath.empty()) {
+            telemetry = std::make_unique<Telemetry::Exporter>(telemetryPath, std::chrono::seconds(1));
+        }
+        std::unique_ptr<SharedStation> station;
+        if (shared) {
+            if (!options.savePath.empty()) {
+                throw std::invalid_argument("--save cannot be used with --shared");
             }
+            station = std::make_unique<SharedStation>(world);
+            options.station = station.get();
         }
-        catch (const std::exception& e) {
-            std::cout << AnsiArt::RED << "Error: " << e.what() << AnsiArt::RESET << std::endl;
+
+        if (listenPort) {
+            if (!options.savePath.empty()) {
+                throw std::invalid_argument("--save cannot be used with --listen");
+            }
+            Gateway::Options gatewayOptions;
+            gatewayOptions.port = *listenPort;
+            gatewayOptions.tickRate = tickRate;
+            gatewayOptions.tickThreads = threadCount;
+            gatewayOptions.game = options;
+            Gateway gateway(gatewayOptions, world, journal.get());
+            return gateway.run();
         }
 
-    }
-};
+        std::ifstream script;
+        if (!scriptPath.empty()) {
+            script.open(scriptPath);
+            if (!script) {
+                throw std::runtime_error("Cannot open script " + scriptPath);
+            }
+        }
+
+        if (sessionCount > 0) {
+            if (scriptPath.empty()) {
+                throw std::invalid_argument("--sessions requires --script");
+            }
+            std::stringstream contents;
+            contents << script.rdbuf();
+            return runSessions(contents.str(), sessionCount, threadCount, options.seed, world,
+                               options.savePath, journal.get(), station.get());
+        }
 
+        NullStream nullOut;
+        std::istream& source = scriptPath.empty() ? std::cin : script;
+        std::unique_ptr<SessionJournal> recorder;
+        std::istream journaled(nullptr);
+        if (journal) {
+            recorder = std::make_unique<SessionJournal>(*journal, source.rdbuf());
+            journaled.rdbuf(recorder.get());
+            options.journal = recorder.get();
+        }
+        std::istream& input = journal ? journaled : source;
+
+        // Frames go straight to stdout in one write each. On a terminal only
+        // the rows that changed are redrawn, and interactive sessions animate
+        // their text on the shared scheduler on top of that.
+        FrameBuffer frame;
+        std::unique_ptr<ScreenDiffBuffer> screen;
+        if (!quiet && ::isatty(STDOUT_FILENO)) {
+            screen = std::make_unique<ScreenDiffBuffer>(&frame);
+        }
+        std::streambuf* display = screen ? static_cast<std::streambuf*>(screen.get()) : &frame;
+        std::ostream displayOut(display);
+        std::unique_ptr<TypewriterBuffer> animated;
+        std::ostream animatedOut(nullptr);
+        if (!options.headless && !quiet) {
+            animated = std::make_unique<TypewriterBuffer>(display);
+            animatedOut.rdbuf(animated.get());
+        }
+        std::ostream& gameOut = animated ? animatedOut
+                              : quiet ? static_cast<std::ostream&>(nullOut) : displayOut;
 
-int main() {
-    try {
-        Game game;
+        Game game(input, gameOut, options, world);
         game.run();
+        if (animated) {
+            animated->drain();
+        }
+        if (journal) {
+            journal->sync();
+        }
         return 0;
     }
     catch (const std::exception& e) {
@@ -979,3 +6745,5 @@ int main() {
         return 1;
     }
 }
+
+#endif // SPACE_DYSTOPIA_NO_MAIN
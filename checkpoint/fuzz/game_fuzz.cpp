@@ -0,0 +1,147 @@
+// Fuzz target: drives one headless session of the built-in world from a
+// byte stream and checks the session's invariants (Game::checkInvariants)
+// after everything it does. Nothing is printed and nothing sleeps, so a core
+// runs millions of inputs an hour.
+//
+// The first eight bytes seed the session. The rest is its input, fed one
+// line at a time. A line made of byte 0x01 and one more byte b ticks the
+// world clock (b + 1) * 16 times instead.
+//
+// With Clang this is a libFuzzer target:
+//   clang++ -std=c++17 -O1 -g -fsanitize=fuzzer,address,undefined -pthread
+//           -o game_fuzz checkpoint/fuzz/game_fuzz.cpp
+//   ./game_fuzz corpus/
+// Built with SPACE_DYSTOPIA_FUZZ_DRIVER it brings a main() of its own that
+// runs the inputs in the files it is given, or random ones:
+//   game_fuzz <file>...
+//   game_fuzz --random <n> [--seed <n>]
+
+#define SPACE_DYSTOPIA_NO_MAIN
+#include "../checkpoint5.cpp"
+
+namespace {
+
+void check(const Game& game) {
+    try {
+        game.checkInvariants();
+    } catch (const std::logic_error& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        std::abort();
+    }
+}
+
+void play(Game& game, std::string_view input) {
+    bool playing = true;
+    while (playing && !input.empty()) {
+        size_t end = input.find('\n');
+        std::string_view line = input.substr(0, end);
+        input.remove_prefix(end == std::string_view::npos ? input.size() : end + 1);
+        if (line.size() == 2 && line[0] == '\x01') {
+            if (game.active()) {
+                game.tick((static_cast<uint8_t>(line[1]) + 1u) * 16u);
+            }
+        } else {
+            game.feed(line);
+            game.feed("\n");
+            playing = game.step();
+        }
+        check(game);
+    }
+    game.endInput();
+    game.step();
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    uint64_t seed = 0;
+    if (size > 0) {
+        std::memcpy(&seed, data, std::min<size_t>(size, sizeof(seed)));
+    }
+    std::string_view input(reinterpret_cast<const char*>(data), size);
+    input.remove_prefix(std::min(size, sizeof(seed)));
+
+    NullStream output;
+    GameOptions options;
+    options.headless = true;
+    options.seed = seed;
+    Game game(output, options);
+    check(game);
+    try {
+        play(game, input);
+    } catch (const std::invalid_argument&) {
+        // The session refused the player's name, which ends it
+    }
+    check(game);
+    return 0;
+}
+
+#ifdef SPACE_DYSTOPIA_FUZZ_DRIVER
+
+namespace {
+
+// Input that has a fair chance of getting somewhere: a name, then mostly
+// menu choices, with now and then a tick or some junk
+std::string randomInput(Rng& rng) {
+    static const char* const tokens[] = {
+        "1", "2", "3", "4", "5", "6", "0", "7", "", " ", "abc", "-1", "+2", "99999999999", "3x", "\t1"
+    };
+    std::string input(sizeof(uint64_t), '\0');
+    uint64_t seed = rng.next();
+    std::memcpy(&input[0], &seed, sizeof(seed));
+    input += rng.chance(0.9) ? "Fuzz\n" : "\n";
+    for (int i = rng.range(0, 150); i > 0; --i) {
+        if (rng.chance(0.05)) {
+            input += '\x01';
+            input += static_cast<char>(rng.range(0, 255));
+        } else {
+            input += tokens[rng.range(0, static_cast<int>(std::size(tokens)) - 1)];
+        }
+        input += '\n';
+    }
+    return input;
+}
+
+void run(const std::string& input) {
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t randomCount = 0;
+    uint64_t seed = 1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--random" && i + 1 < argc) {
+            randomCount = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& path : files) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Cannot open " << path << std::endl;
+            return 1;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        run(contents.str());
+    }
+    Rng rng(seed);
+    for (size_t i = 0; i < randomCount; ++i) {
+        run(randomInput(rng));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cerr << "Ran " << files.size() + randomCount << " inputs in " << elapsed.count() << " ms" << std::endl;
+    return 0;
+}
+
+#endif // SPACE_DYSTOPIA_FUZZ_DRIVER
@@ -0,0 +1,280 @@
+// Monte Carlo combat balance simulator. Runs millions of fights with the
+// game's own combat rules (Combat::CombatTable, PlayerStats) and
+// reports win rate, turns-to-kill and damage taken.
+//
+// Build: g++ -std=c++17 -O2 -pthread -o combat_sim checkpoint/tools/combat_sim.cpp
+//
+// Usage: combat_sim [--enemy <name>] [--enemy-stats <health>/<attack>/<defense>]
+//                   [--level <n>] [--emp <probability>] [--fights <n>]
+//                   [--threads <n>] [--seed <n>] [--world <file>]
+//   --enemy        enemy from the world to fight (default: Security Bot)
+//   --enemy-stats  override the enemy's stats
+//   --level        player level; each level past 1 applies the levelUp gains
+//   --emp          chance per turn that the player uses the EMP
+//                  (0 = never, 1 = always); an EMP hit deals double damage
+//                  and the enemy does not strike back that turn
+//   --fights       number of fights to simulate (default: 1000000)
+//   --threads      worker threads (default: one per core)
+//   --seed         base seed; thread i uses its own stream derived from it
+
+#define SPACE_DYSTOPIA_NO_MAIN
+#include "../checkpoint5.cpp"
+
+namespace {
+
+struct FighterStats {
+    int health;
+    int attack;
+    int defense;
+    int variance;
+};
+
+struct SimConfig {
+    FighterStats player;
+    FighterStats enemy;
+    double empChance;
+    int maxTurns;
+};
+
+// Per-thread tallies; histograms are indexed by turns and by damage taken
+struct SimResults {
+    uint64_t fights = 0;
+    uint64_t wins = 0;
+    uint64_t losses = 0;
+    uint64_t draws = 0;
+    std::vector<uint64_t> turns;
+    std::vector<uint64_t> damageTaken;
+
+    SimResults(int maxTurns, int playerHealth)
+        : turns(maxTurns + 1, 0), damageTaken(playerHealth + 1, 0) {}
+
+    void merge(const SimResults& other) {
+        fights += other.fights;
+        wins += other.wins;
+        losses += other.losses;
+        draws += other.draws;
+        for (size_t i = 0; i < turns.size(); ++i) turns[i] += other.turns[i];
+        for (size_t i = 0; i < damageTaken.size(); ++i) damageTaken[i] += other.damageTaken[i];
+    }
+};
+
+// Fights are simulated in batches: every turn resolves the player strikes
+// of all fights still running in one pass, then the counter-strikes
+const size_t BATCH_SIZE = 1024;
+
+void simulateBatch(const SimConfig& config, size_t fights, Rng& rng, SimResults& results,
+                   Combat::CombatTable& table, std::vector<Combat::Strike>& strikes,
+                   std::vector<int>& dealt, std::vector<uint32_t>& running) {
+    table.clear();
+    running.clear();
+    for (size_t i = 0; i < fights; ++i) {
+        table.add(config.player.health, config.player.attack, config.player.defense, config.player.variance);
+        table.add(config.enemy.health, config.enemy.attack, config.enemy.defense, config.enemy.variance);
+        running.push_back(static_cast<uint32_t>(i));
+    }
+
+    std::vector<char> usedEmp(fights, 0);
+    for (int turn = 1; turn <= config.maxTurns && !running.empty(); ++turn) {
+        strikes.clear();
+        for (uint32_t fight : running) {
+            usedEmp[fight] = rng.chance(config.empChance);
+            strikes.push_back({2 * fight, 2 * fight + 1, usedEmp[fight] ? 2 : 1});
+        }
+        dealt.resize(strikes.size());
+        table.resolve(strikes.data(), strikes.size(), rng, dealt.data());
+
+        strikes.clear();
+        for (uint32_t fight : running) {
+            if (!usedEmp[fight] && table.isAlive(2 * fight + 1)) {
+                strikes.push_back({2 * fight + 1, 2 * fight, 1});
+            }
+        }
+        dealt.resize(strikes.size());
+        table.resolve(strikes.data(), strikes.size(), rng, dealt.data());
+
+        size_t kept = 0;
+        for (uint32_t fight : running) {
+            bool playerAlive = table.isAlive(2 * fight);
+            bool enemyAlive = table.isAlive(2 * fight + 1);
+            if (playerAlive && enemyAlive) {
+                running[kept++] = fight;
+                continue;
+            }
+            if (!enemyAlive) {
+                results.wins++;
+                results.turns[turn]++;
+            } else {
+                results.losses++;
+            }
+            results.damageTaken[config.player.health - table.health[2 * fight]]++;
+        }
+        running.resize(kept);
+    }
+
+    for (uint32_t fight : running) {
+        results.draws++;
+        results.damageTaken[config.player.health - table.health[2 * fight]]++;
+    }
+    results.fights += fights;
+}
+
+void simulate(const SimConfig& config, uint64_t fights, uint64_t seed, SimResults& results) {
+    Rng rng(seed);
+    Combat::CombatTable table;
+    std::vector<Combat::Strike> strikes;
+    std::vector<int> dealt;
+    std::vector<uint32_t> running;
+    for (uint64_t done = 0; done < fights; done += BATCH_SIZE) {
+        size_t batch = static_cast<size_t>(std::min<uint64_t>(BATCH_SIZE, fights - done));
+        simulateBatch(config, batch, rng, results, table, strikes, dealt, running);
+    }
+}
+
+// Value at the given fraction of the histogram's total count
+size_t percentile(const std::vector<uint64_t>& histogram, double fraction) {
+    uint64_t total = std::accumulate(histogram.begin(), histogram.end(), uint64_t(0));
+    uint64_t target = static_cast<uint64_t>(fraction * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen > target) {
+            return i;
+        }
+    }
+    return histogram.empty() ? 0 : histogram.size() - 1;
+}
+
+void printDistribution(const std::string& label, const std::vector<uint64_t>& histogram) {
+    uint64_t total = 0;
+    double sum = 0;
+    size_t maximum = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        total += histogram[i];
+        sum += static_cast<double>(i) * histogram[i];
+        if (histogram[i] > 0) {
+            maximum = i;
+        }
+    }
+    std::cout << std::left << std::setw(15) << label;
+    if (total == 0) {
+        std::cout << "n/a" << std::endl;
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(2) << "mean " << sum / total
+              << "  p50 " << percentile(histogram, 0.50)
+              << "  p90 " << percentile(histogram, 0.90)
+              << "  p99 " << percentile(histogram, 0.99)
+              << "  max " << maximum << std::endl;
+}
+
+FighterStats fighter(const StatBlock& stats) {
+    return {stats.get<Stats::HEALTH>(), stats.get<Stats::ATTACK>(), stats.get<Stats::DEFENSE>(),
+            stats.get<Stats::VARIANCE>()};
+}
+
+FighterStats parseStats(const std::string& text) {
+    FighterStats stats{0, 0, 0, 1};
+    char slash1 = 0, slash2 = 0;
+    std::istringstream stream(text);
+    if (!(stream >> stats.health >> slash1 >> stats.attack >> slash2 >> stats.defense) ||
+        slash1 != '/' || slash2 != '/' || stats.health <= 0) {
+        throw std::invalid_argument("Expected <health>/<attack>/<defense>, got " + text);
+    }
+    return stats;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string enemyName = "Security Bot";
+    std::optional<FighterStats> enemyOverride;
+    std::string worldPath;
+    int level = 1;
+    double empChance = 0.0;
+    uint64_t fights = 1000000;
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t seed = 1;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--enemy" && i + 1 < argc) {
+                enemyName = argv[++i];
+            } else if (arg == "--enemy-stats" && i + 1 < argc) {
+                enemyOverride = parseStats(argv[++i]);
+            } else if (arg == "--level" && i + 1 < argc) {
+                level = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--emp" && i + 1 < argc) {
+                empChance = std::stod(argv[++i]);
+            } else if (arg == "--fights" && i + 1 < argc) {
+                fights = std::stoull(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threadCount = std::max<size_t>(1, std::stoul(argv[++i]));
+            } else if (arg == "--seed" && i + 1 < argc) {
+                seed = std::stoull(argv[++i]);
+            } else if (arg == "--world" && i + 1 < argc) {
+                worldPath = argv[++i];
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+
+        SimConfig config;
+        config.player = fighter(PlayerStats::atLevel(level));
+        config.empChance = empChance;
+        config.maxTurns = 1000;
+
+        if (enemyOverride) {
+            config.enemy = *enemyOverride;
+        } else {
+            auto world = worldPath.empty() ? WorldData::builtin() : WorldData::load(worldPath);
+            auto it = std::find_if(world->enemies.begin(), world->enemies.end(),
+                [&enemyName](const WorldData::EnemyDef& def) { return def.name == enemyName; });
+            if (it == world->enemies.end()) {
+                throw std::invalid_argument("No enemy named " + enemyName);
+            }
+            EntityStore entities;
+            EntityId enemy = entities.createEnemy(it->name, it->type, it->health, it->attack, it->defense);
+            config.enemy = fighter(entities.stats[enemy]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<SimResults> perThread(threadCount, SimResults(config.maxTurns, config.player.health));
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threadCount; ++t) {
+            uint64_t share = fights / threadCount + (t < fights % threadCount ? 1 : 0);
+            // Each thread gets its own stream; Rng::reseed spreads nearby seeds apart
+            uint64_t streamSeed = seed * 0x9E3779B97F4A7C15ull + t;
+            workers.emplace_back(simulate, std::cref(config), share, streamSeed, std::ref(perThread[t]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        SimResults total(config.maxTurns, config.player.health);
+        for (const auto& results : perThread) {
+            total.merge(results);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto percent = [&total](uint64_t count) {
+            return total.fights ? 100.0 * count / total.fights : 0.0;
+        };
+        std::cout << enemyName << " (" << config.enemy.health << "/" << config.enemy.attack << "/"
+                  << config.enemy.defense << ") vs player level " << level << " ("
+                  << config.player.health << "/" << config.player.attack << "/" << config.player.defense
+                  << "), EMP chance " << empChance << std::endl;
+        std::cout << std::fixed << std::setprecision(2)
+                  << "fights: " << total.fights << "  wins " << percent(total.wins) << "%  losses "
+                  << percent(total.losses) << "%  draws " << percent(total.draws) << "%" << std::endl;
+        printDistribution("turns to kill:", total.turns);
+        printDistribution("damage taken:", total.damageTaken);
+        std::cout << std::setprecision(1) << "elapsed: " << seconds * 1000 << " ms ("
+                  << (seconds > 0 ? total.fights / seconds / 1e6 : 0.0) << "M fights/s on "
+                  << threadCount << " threads)" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+}